@@ -0,0 +1,134 @@
+/*** arena.c -- bump allocator for portfolio data
+ *
+ * LICENCE here
+ **/
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "arena.h"
+
+/* enough for doubles and pointers */
+#define ALGN		(16U)
+#define CHUNK_MIN	(16384U)
+
+struct chunk_s {
+	struct chunk_s *next;
+	size_t z;
+	size_t off;
+	/* keep the data aligned */
+	uintptr_t pad;
+	unsigned char data[];
+};
+
+struct arena_s {
+	/* chunks in order of creation, we allocate off cur */
+	struct chunk_s *head;
+	struct chunk_s *cur;
+	size_t nmalloc;
+};
+
+
+static struct chunk_s*
+make_chunk(arena_t a, size_t z)
+{
+	struct chunk_s *res = malloc(sizeof(*res) + z);
+
+	res->next = NULL;
+	res->z = z;
+	res->off = 0U;
+	a->nmalloc++;
+	return res;
+}
+
+
+DEFUN arena_t
+make_arena(void)
+{
+	arena_t res = calloc(1, sizeof(*res));
+	res->nmalloc++;
+	return res;
+}
+
+DEFUN void
+free_arena(arena_t a)
+{
+	for (struct chunk_s *c = a->head, *nx; c != NULL; c = nx) {
+		nx = c->next;
+		free(c);
+	}
+	free(a);
+	return;
+}
+
+DEFUN void
+arena_reset(arena_t a)
+{
+	if ((a->cur = a->head) != NULL) {
+		a->cur->off = 0U;
+	}
+	return;
+}
+
+DEFUN void*
+arena_alloc(arena_t a, size_t z)
+{
+	struct chunk_s *c = a->cur;
+	void *res;
+
+	/* round up so the next one stays aligned */
+	z = (z + ALGN - 1U) & ~(size_t)(ALGN - 1U);
+	while (c == NULL || c->off + z > c->z) {
+		if (c != NULL && c->next != NULL) {
+			/* reuse chunks from before the last reset */
+			c = c->next;
+			c->off = 0U;
+			continue;
+		}
+		/* chunks grow geometrically */
+		size_t nuz = c != NULL ? 2U * c->z : CHUNK_MIN;
+		struct chunk_s *nu;
+
+		while (nuz < z) {
+			nuz *= 2U;
+		}
+		nu = make_chunk(a, nuz);
+		if (c != NULL) {
+			c->next = nu;
+		} else {
+			a->head = nu;
+		}
+		c = nu;
+	}
+	a->cur = c;
+	res = c->data + c->off;
+	c->off += z;
+	return res;
+}
+
+DEFUN void*
+arena_calloc(arena_t a, size_t n, size_t z)
+{
+	void *res = arena_alloc(a, n * z);
+	memset(res, 0, n * z);
+	return res;
+}
+
+DEFUN char*
+arena_strndup(arena_t a, const char *s, size_t n)
+{
+	char *res;
+
+	n = strnlen(s, n);
+	res = arena_alloc(a, n + 1U);
+	memcpy(res, s, n);
+	res[n] = '\0';
+	return res;
+}
+
+DEFUN size_t
+arena_nmalloc(arena_t a)
+{
+	return a->nmalloc;
+}
+
+/* arena.c ends here */
@@ -0,0 +1,44 @@
+/*** arena.h -- bump allocator for portfolio data
+ *
+ * LICENCE here
+ **/
+#if !defined INCLUDED_arena_h_
+#define INCLUDED_arena_h_
+
+#include <stddef.h>
+
+#if !defined DECLF
+# define DECLF	extern
+# define DEFUN
+#endif	/* !DECLF */
+
+/**
+ * Memory is handed out from a chain of chunks of geometrically growing
+ * size and given back all at once by resetting the arena. */
+typedef struct arena_s *arena_t;
+
+DECLF arena_t make_arena(void);
+DECLF void free_arena(arena_t);
+
+/**
+ * Forget about everything allocated from A, in constant time.
+ * The chunks are kept to serve further allocations. */
+DECLF void arena_reset(arena_t a);
+
+/**
+ * Return Z bytes of suitably aligned memory off A. */
+DECLF void *arena_alloc(arena_t a, size_t z);
+
+/**
+ * Like arena_alloc() but zero the memory, like calloc(). */
+DECLF void *arena_calloc(arena_t a, size_t n, size_t z);
+
+/**
+ * Copy the first N bytes of S into A and terminate them. */
+DECLF char *arena_strndup(arena_t a, const char *s, size_t n);
+
+/**
+ * Return the number of chunks ever malloc'd for A. */
+DECLF size_t arena_nmalloc(arena_t a);
+
+#endif	/* INCLUDED_arena_h_ */
@@ -8,1112 +8,1075 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "durst.h"
+#include "pool.h"
 
-#include "urs.h"
-#include "urs_fut.h"
-#include "urs_cash.h"
-
-#include "iso4217.h"
-#include "iso4217.c"
-
-#if defined DEBUG_FLAG
-# define URS_DEBUG(args...)	fprintf(stderr, "[urs] " args);
-#else  /* !DEBUG_FLAG */
-# define URS_DEBUG(args...)
-#endif	/* DEBUG_FLAG */
-#if !defined UNUSED
-# define UNUSED(x)	__attribute__((unused)) x
-#endif	/* !UNUSED */
-
-#define countof(x)	(sizeof(x) / sizeof(*x))
-
-typedef struct pos_s *pos_t;
-typedef struct pf_s *pf_t;
-
-typedef struct __nav_pos_s *urs_nav_pos_t;
-
-/* specific guys */
-struct fx_pos_s {
-	struct __hdr_s base;
-	struct __hdr_s term;
+/* we need:
+ * FUT name ccy pos fbid fask fstl rbid rask rstl lo tgt hi fee
+ * CASH name ccy soft_pos hard_pos bid ask stl lo tgt hi soft_fee hard_fee
+ */
+#if defined __INTEL_COMPILER
+# pragma warning (disable:593)
+#endif	/* __INTEL_COMPILER */
+#include "durst-clo.h"
+#include "durst-clo.c"
+#if defined __INTEL_COMPILER
+# pragma warning (default:593)
+#endif	/* __INTEL_COMPILER */
 
-	struct __mkt_s rate;
-};
+static const char base_ccy[] = "EUR";
 
-struct __nav_pos_s {
-	/* ident stuff */
-	struct __hdr_s hdr;
+static void
+__proc(durst_ctx_t ctx, durst_pf_t pf,
+       const struct gengetopt_args_info *argi, bool navp,
+       FILE *out, FILE *err, FILE *st)
+{
+	/* establish base currency, this runs on workers while the reader
+	 * may add custom currencies, fine as long as base_ccy is ISO */
+	durst_pf_set_base(ctx, pf, base_ccy);
 
-	/* this currency */
-	const_pfack_4217_t tccy;
+	/* adapt levers */
+	if (argi->lever_given) {
+		durst_pf_lever(pf, argi->lever_arg);
+	}
 
-	/* characteristics, track soft and hard positions,
-	 * we distinguish forex positions here as well because we must
-	 * not introduce instruments ourselves, as long as we don't do
-	 * FX positions anyway.
-	 * a forex long position would mean, buy the currency in question,
-	 * debitting the base currency position, short vice versa */
-	struct __val_s base;
+	if (!durst_pf_complete_p(pf)) {
+		/* just refuse to do stuff*/
+		if (durst_pf_id(pf) != NULL) {
+			fprintf(err, "%s\t", durst_pf_id(pf));
+		}
+		fprintf(err, "DATA INCOMPLETE ... CUNT OFF\n");
+	} else if (navp) {
+		durst_pf_emit_report(pf, out);
+	} else {
+		durst_pf_rebalance(pf);
+		durst_pf_emit_report(pf, err);
+		if (argi->stats_given) {
+			double resid;
+			size_t niter = durst_pf_solve_stats(pf, &resid);
+
+			fprintf(err, "SOLVE\titer %zu\tresid %.6e\n",
+				niter, resid);
+		}
 
-	double soft_ini;
-	double hard_ini;
-};
+		/* print a list of trades so we can settle this crap */
+		switch (argi->outfmt_arg) {
+		case outfmt_arg_csv:
+			durst_pf_emit_trades(pf, out, DURST_OUTFMT_CSV);
+			break;
+		case outfmt_arg_fixml:
+			durst_pf_emit_trades(pf, out, DURST_OUTFMT_FIXML);
+			break;
+		case outfmt_arg_bin:
+			durst_pf_emit_trades(pf, out, DURST_OUTFMT_BIN);
+			break;
+		default:
+			break;
+		}
+		if (st != NULL) {
+			durst_pf_emit_state(pf, st);
+		}
+	}
+	return;
+}
 
-typedef enum {
-	POSTY_UNK,
-	POSTY_FUT,
-	POSTY_CASH,
-	POSTY_FX,
-	POSTY_FXFW,
-	POSTY_STK,
-	POSTY_NAV,
-} posty_t;
-
-struct pos_s {
-	posty_t ty;
-	union {
-		struct __fut_pos_s fut;
-		struct __cash_pos_s cash;
-		struct __nav_pos_s nav;
-	};
+/* parallel mode, portfolios are rebalanced by a pool of workers
+ * and their output is buffered until all portfolios before them
+ * are printed, so the output order is that of the input */
+struct job_s {
+	durst_pf_t pf;
+	struct bat_s *b;
+	struct job_s *next;
+
+	/* buffered stdout and stderr, and state */
+	char *out;
+	size_t outz;
+	char *err;
+	size_t errz;
+	char *st;
+	size_t stz;
+	bool donep;
 };
 
-struct pf_s {
-	/* hard */
-	struct __val_s val;
-	struct __val_s val_ini;
-	const_pfack_4217_t bccy;
-
-	size_t nposs;
-	struct pos_s poss[];
+struct bat_s {
+	durst_ctx_t ctx;
+	const struct gengetopt_args_info *argi;
+	/* NULL if working serially */
+	pool_t pool;
+	/* max number of jobs in flight */
+	size_t maxj;
+	/* snapshot to write portfolios to as they're read, or NULL */
+	durst_snap_t snap;
+	/* state file to leave the portfolios' navs in, or NULL */
+	FILE *st;
+
+	/* the reorder buffer, guarded by mtx */
+	pthread_mutex_t mtx;
+	pthread_cond_t cnd;
+	struct job_s *head;
+	struct job_s **tail;
+	size_t njobs;
 };
 
-
-/* posty specific accessors */
-static double
-pos_soft(pos_t p)
-{
-	switch (p->ty) {
-	case POSTY_FUT:
-		return p->fut.pos.soft;
-	case POSTY_CASH:
-		return p->cash.term.soft;
-	default:
-		return 0.0;
-	}
-}
-
-static double
-pos_hard(pos_t p)
+static void
+__proc_job(void *clo)
 {
-	switch (p->ty) {
-	case POSTY_FUT:
-		return p->fut.pos.hard;
-	case POSTY_CASH:
-		return p->cash.term.hard;
-	default:
-		return 0.0;
+	struct job_s *j = clo;
+	struct bat_s *b = j->b;
+	FILE *out = open_memstream(&j->out, &j->outz);
+	FILE *err = open_memstream(&j->err, &j->errz);
+	FILE *st = b->st ? open_memstream(&j->st, &j->stz) : NULL;
+
+	__proc(b->ctx, j->pf, b->argi, b->argi->nav_only_given, out, err, st);
+	fclose(out);
+	fclose(err);
+	if (st != NULL) {
+		fclose(st);
 	}
-}
+	free_durst_pf(j->pf);
 
-static double
-pos_soft_val(pos_t p)
-{
-	switch (p->ty) {
-	case POSTY_FUT:
-		return p->fut.base.soft = p->fut.term.soft = 0.0;
-	case POSTY_CASH: {
-		double b_s = p->cash.term.soft / p->cash.s_mkt.stl;
-		double b_fx = p->cash.forex / p->cash.s_mkt.stl;
-		return (p->cash.base.soft = b_s) + b_fx;
-	}
-	default:
-		return 0.0;
-	}
+	pthread_mutex_lock(&b->mtx);
+	j->donep = true;
+	pthread_cond_broadcast(&b->cnd);
+	pthread_mutex_unlock(&b->mtx);
+	return;
 }
 
-static double
-pos_hard_val(pos_t p)
+static void
+bat_flush(struct bat_s *b, size_t upto)
 {
-	switch (p->ty) {
-	case POSTY_FUT:
-		return p->fut.base.hard =
-			p->fut.term.hard / p->fut.val_fac;
-	case POSTY_CASH:
-		return p->cash.base.hard =
-			p->cash.term.hard / p->cash.s_mkt.stl;
-	default:
-		return 0.0;
-	}
-}
+/* print finished jobs in order, block until no more than UPTO are left */
+	while (true) {
+		struct job_s *j;
 
-static double
-compute_pf_val(pf_t pf)
-{
-	pf->val = pf->val_ini;
-
-	for (size_t i = 0; i < pf->nposs; i ++) {
-		if (pf->val_ini.hard == 0.0 || pf->poss[i].ty != POSTY_CASH) {
-			/* only add stuff up if the portfolio hasn't
-			 * had a hard-set NAV */
-			pf->val.soft += pos_soft_val(pf->poss + i);
-			pf->val.hard += pos_hard_val(pf->poss + i);
+		pthread_mutex_lock(&b->mtx);
+		while ((j = b->head) != NULL && !j->donep && b->njobs > upto) {
+			pthread_cond_wait(&b->cnd, &b->mtx);
 		}
-	}
-	URS_DEBUG("pf_val() soft %.6f hard %.6f\n", pf->val.soft, pf->val.hard);
-	return pf->val.soft + pf->val.hard;
-}
-
-static urs_cash_pos_t
-find_cash_pos(pf_t pf, pos_t pos)
-{
-	switch (pos->ty) {
-	case POSTY_CASH:
-		return &pos->cash;
-	case POSTY_FUT:
-		for (size_t i = 0; i < pf->nposs; i++) {
-			if (pf->poss[i].ty == POSTY_CASH &&
-			    pf->poss[i].cash.tccy == pos->fut.ccy) {
-				return &pf->poss[i].cash;
-			}
+		if (j == NULL || !j->donep) {
+			pthread_mutex_unlock(&b->mtx);
+			break;
 		}
-	default:
-		return NULL;
-	}
-}
-
-/* future rebalancing relative to the NAV of the portfolio */
-static int
-reba_relanav_pos(pos_t pos, double tnav)
-{
-	switch (pos->ty) {
-		double hard, soft;
-		double ratio;
-		double lo, hi;
-	default:
-		break;
-
-	case POSTY_CASH:
-		soft = pos->cash.term.soft;
-		hard = pos->cash.term.hard;
-		ratio = (soft + hard) / tnav;
-		lo = pos->cash.band.lo;
-		hi = pos->cash.band.hi;
-
-		if ((lo = pos->cash.band.lo) < 0.0 ||
-		    (hi = pos->cash.band.hi) < 0.0 ||
-		    ratio < lo || ratio > hi) {
-			urs_cash_relanav(&pos->cash, tnav);
+		if ((b->head = j->next) == NULL) {
+			b->tail = &b->head;
 		}
-		break;
+		b->njobs--;
+		pthread_mutex_unlock(&b->mtx);
 
-	case POSTY_FUT:
-		soft = pos->fut.pos.soft;
-		hard = pos->fut.pos.hard;
-		ratio = (soft + hard) / tnav;
-		lo = pos->fut.band.lo;
-		hi = pos->fut.band.hi;
-
-		if (ratio < lo || ratio > hi) {
-			urs_fut_relanav(&pos->fut, tnav);
+		fwrite(j->err, 1, j->errz, stderr);
+		fwrite(j->out, 1, j->outz, stdout);
+		if (j->st != NULL) {
+			fwrite(j->st, 1, j->stz, b->st);
 		}
-		break;
+		free(j->err);
+		free(j->out);
+		free(j->st);
+		free(j);
 	}
-	return 0;
+	return;
 }
 
-static bool
-reba_relanav_check(pf_t pf, double nav)
+static void
+bat_enq(struct bat_s *b, struct job_s *j)
 {
-	bool res = true;
-
-	for (size_t i = 0; i < pf->nposs; i++) {
-		double lo, hi;
-		double ratio;
-		/* the nav we give here is relative to the ccy of the pos */
-		urs_cash_pos_t cp = find_cash_pos(pf, pf->poss + i);
-		double tnav = cp ? nav * cp->s_mkt.stl : 0.0;
-		double hard, soft;
-
-		switch (pf->poss[i].ty) {
-		default:
-			continue;
-
-		case POSTY_CASH:
-			/* convert nav to term_nav, needed for the rolandique
-			 * definition of exposures */
-			soft = pf->poss[i].cash.term.soft;
-			hard = pf->poss[i].cash.term.hard;
-
-			ratio = (soft + hard) / tnav;
-			if ((lo = pf->poss[i].cash.band.lo) < 0.0 ||
-			    (hi = pf->poss[i].cash.band.hi) < 0.0) {
-				continue;
-			}
-			break;
-
-		case POSTY_FUT:
-			soft = pf->poss[i].fut.pos.soft;
-			hard = pf->poss[i].fut.pos.hard;
-
-			ratio = (soft + hard) / tnav;
-			lo = pf->poss[i].fut.band.lo;
-			hi = pf->poss[i].fut.band.hi;
-			break;
-		}
-
-		if (ratio < lo || ratio > hi) {
-			URS_DEBUG("\
-NEED REBA %s (%.4f/%.4f): %.8g < %.8g < %.8g NOT\n",
-				  pf->poss[i].fut.hdr.sym,
-				  soft, hard, lo, ratio, hi);
-			res = false;
-#if !defined DEBUG_FLAG
-			break;
-#endif	/* DEBUG_FLAG */
-		}
-	}
-	return res;
+	pthread_mutex_lock(&b->mtx);
+	*b->tail = j;
+	b->tail = &j->next;
+	b->njobs++;
+	pthread_mutex_unlock(&b->mtx);
+	return;
 }
 
 static void
-reba_relanav(pf_t pf, double nav)
+bat_push(struct bat_s *b, durst_pf_t pf)
 {
-	if (reba_relanav_check(pf, nav)) {
-		URS_DEBUG("NO REBA NEEDED\n");
+	struct job_s *j;
+
+	if (b->pool == NULL) {
+		__proc(b->ctx, pf, b->argi, b->argi->nav_only_given,
+		       stdout, stderr, b->st);
+		free_durst_pf(pf);
 		return;
 	}
 
-	URS_DEBUG("NEED REBA\n");
-	for (size_t i = 0; i < pf->nposs; i++) {
-		/* the nav we give here is relative to the ccy of the pos */
-		urs_cash_pos_t cp = find_cash_pos(pf, pf->poss + i);
-		double tnav = cp ? nav * cp->s_mkt.stl : 0.0;
-		reba_relanav_pos(pf->poss + i, tnav);
-		URS_DEBUG("reba'd %s to %.4f (%.4f) (tnav %.4f)\n",
-			  pf->poss[i].fut.hdr.sym,
-			  pos_hard(pf->poss + i),
-			  pos_soft(pf->poss + i),
-			  tnav);
-	}
+	j = calloc(1, sizeof(*j));
+	j->pf = pf;
+	j->b = b;
+	bat_enq(b, j);
+
+	pool_push(b->pool, __proc_job, j);
+	/* print what's done already, and don't let the buffer grow */
+	bat_flush(b, b->maxj);
 	return;
 }
 
-
-/* test setup */
-static size_t nmy4217 = 0;
-static struct pfack_4217_s my4217[16];
-
 static void
-free_pf(pf_t pf)
+bat_cannot(struct bat_s *b, const char *what, const char *fn)
 {
-	for (size_t i = 0; i < pf->nposs; i++) {
-		pos_t p = pf->poss + i;
-		switch (p->ty) {
-		case POSTY_CASH:
-			free(p->cash.hdr.sym);
-			break;
-		case POSTY_FUT:
-			free(p->fut.hdr.sym);
-			break;
-		default:
-			break;
-		}
+/* complain about FN in input order, i.e. behind the reports of the
+ * portfolios read before */
+	struct job_s *j;
+	FILE *err;
+
+	if (b->pool == NULL) {
+		fprintf(stderr, "cannot %s %s\n", what, fn);
+		return;
 	}
-	free(pf);
+
+	j = calloc(1, sizeof(*j));
+	err = open_memstream(&j->err, &j->errz);
+	fprintf(err, "cannot %s %s\n", what, fn);
+	fclose(err);
+	j->donep = true;
+	bat_enq(b, j);
+	bat_flush(b, b->maxj);
 	return;
 }
 
-static void
-fprint_pos(pf_t pf, pos_t pos, double nav, FILE *whither)
+static int
+bat_read(struct bat_s *b, FILE *whence)
 {
-	switch (pos->ty) {
-	case POSTY_UNK:
-	default:
-		break;
-
-	case POSTY_CASH: {
-		double tcv = urs_cash_value(&pos->cash);
-		double nav = pf->val.soft + pf->val.hard;
-
-		fprintf(whither, "CASH %s\t\
-soft %.4f\thard %.4f\tfx %.4f\t%.6e v %.6e\n",
-			pos->cash.hdr.sym,
-			pos->cash.term.soft,
-			pos->cash.term.hard,
-			pos->cash.forex,
-			tcv / nav, pos->cash.band.med);
-		break;
-	}
-
-	case POSTY_FUT: {
-		urs_cash_pos_t cp = find_cash_pos(pf, pos);
-		double tnav = cp ? nav * cp->s_mkt.stl : 0.0;
-		double ex = cp
-			? (pos->fut.pos.hard + pos->fut.pos.soft) / tnav : 0.0;
-
-		fprintf(whither, "FUT %s\t\
-%.4f (%.4f)\t* %.4f\t@ %.4f/%.4f\t\
-soft %.4f\thard %.4f\t%.6e v %.6e\n",
-			pos->fut.hdr.sym,
-			pos->fut.pos.hard,
-			pos->fut.pos.soft,
-			pos->fut.mult,
-			pos->fut.f_mkt.bid,
-			pos->fut.f_mkt.ask,
-			pos->fut.term.soft,
-			pos->fut.term.hard,
-			ex, pos->fut.band.med);
-		break;
-	}
+	durst_pf_t inpf;
+
+	/* one portfolio at a time, there's more than one in batch mode */
+	while ((inpf = durst_pf_read(b->ctx, whence)) != NULL) {
+		if (b->snap != NULL) {
+			/* snapshots are taken before anything's rebalanced */
+			durst_pf_set_base(b->ctx, inpf, base_ccy);
+			durst_snap_add(b->snap, inpf);
+		}
+		bat_push(b, inpf);
 	}
-	return;
+	return 0;
 }
 
-static void
-fprint_poss(pf_t pf, FILE *whither)
+static int
+bat_read_snap(struct bat_s *b, const char *fn)
 {
-	double nav = compute_pf_val(pf);
-
-	fprintf(whither, "PORTFOLIO\tsoft %2.4f\thard %2.4f\tnav %.4f\n",
-		pf->val.soft, pf->val.hard, nav);
-	for (size_t i = 0; i < pf->nposs; i++) {
-		if (pf->poss[i].ty == POSTY_CASH) {
-			fprintf(whither, "\
-TERM\t%s\tsoft %.4f\thard %.4f\tnav %.4f\n",
-				pf->poss[i].cash.tccy->sym,
-				pf->val.soft * pf->poss[i].cash.s_mkt.stl,
-				pf->val.hard * pf->poss[i].cash.s_mkt.stl,
-				nav * pf->poss[i].cash.s_mkt.stl);
-		}
+	durst_snap_t s;
+	durst_pf_t inpf;
+
+	if ((s = durst_snap_open(b->ctx, fn)) == NULL) {
+		return -1;
 	}
-	for (size_t i = 0; i < pf->nposs; i++) {
-		fprint_pos(pf, pf->poss + i, nav, whither);
+	while ((inpf = durst_snap_read(s)) != NULL) {
+		durst_pf_apply_quotes(b->ctx, inpf);
+		bat_push(b, inpf);
 	}
-	return;
+	durst_snap_close(s);
+	return 0;
 }
 
-static void
-fprint_trades(pf_t pf, FILE *whither)
-{
-	/* traverse the soft pos's to emit trades */
-	for (size_t i = 0; i < pf->nposs; i++) {
-		pos_t p = pf->poss + i;
-
-		switch (p->ty) {
-		case POSTY_CASH: {
-			double d = p->cash.term.hard - p->cash.hard_ini;
-			double dfx = p->cash.forex;
-
-			if (d > 0.0) {
-				fprintf(whither, "CLEAR\t%.4f\t%s\n",
-					d, p->cash.hdr.sym);
-			} else if (d < 0.0) {
-				fprintf(whither, "CLEAR\t%.4f\t%s\n",
-					d, p->cash.hdr.sym);
-			}
+/* server mode, portfolios stay resident and are rebalanced on request
+ * against the quotes of the moment, see --serve for the protocol */
+struct conn_s {
+	int rfd;
+	int wfd;
+	/* whether replies go with binary framing */
+	bool binp;
+	/* input not yet processed */
+	char *buf;
+	size_t bufn;
+	size_t bufz;
+	/* records between PORTFOLIO and END, or NULL */
+	FILE *ld;
+	char *lds;
+	size_t ldz;
+};
 
-			/* do not buy or sell base currency?
-			 * at the moment we use the criterion, if it's not
-			 * balanced do fuckall */
-			if (p->cash.band.med < 0.0) {
-				break;
-			}
+struct srv_s {
+	struct bat_s *b;
+	/* resident portfolios, open-addressed by id, zpf is a power of 2 */
+	size_t npf;
+	size_t zpf;
+	durst_pf_t *pf;
+};
 
-			if (dfx > 0.0) {
-				fprintf(whither, "BUY\t%.4f\t%s\n",
-					dfx, p->cash.tccy->sym);
-			} else if (dfx < 0.0) {
-				fprintf(whither, "SELL\t%.4f\t%s\n",
-					-dfx, p->cash.tccy->sym);
-			}
-			break;
-		}
-		case POSTY_FUT:
-			if (p->fut.pos.soft > 0.0 &&
-			    p->fut.pos.hard < 0.0) {
-				fprintf(whither, "SHORT_BUY\t%.4f\t%s\n",
-					p->fut.pos.soft, p->fut.hdr.sym);
-			} else if (p->fut.pos.soft > 0.0) {
-				fprintf(whither, "BUY\t%.4f\t%s\n",
-					p->fut.pos.soft, p->fut.hdr.sym);
-			} else if (p->fut.pos.soft < 0.0 &&
-				   p->fut.pos.hard > 0.0) {
-				fprintf(whither, "SELL\t%.4f\t%s\n",
-					-p->fut.pos.soft, p->fut.hdr.sym);
-			} else if (p->fut.pos.soft < 0.0) {
-				fprintf(whither, "SHORT_SELL\t%.4f\t%s\n",
-					-p->fut.pos.soft, p->fut.hdr.sym);
-			}
+enum {
+	SRV_OK = 0,
+	SRV_ERR = 1,
+};
 
-			if (p->fut.term.hard != 0.0) {
-				fprintf(whither, "CLEAR\t%.4f\t%s\n",
-					p->fut.term.hard, p->fut.ccy->sym);
-			}
-			if (p->fut.term.soft != 0.0) {
-				fprintf(whither, "CLEAR\t%.4f\t%s\n",
-					p->fut.term.soft, p->fut.ccy->sym);
-			}
-			break;
-		default:
-			break;
-		}
-	}
-	return;
-}
+static volatile sig_atomic_t srv_quitp;
 
 static void
-fprint_trades_fixml(pf_t pf, FILE *whither)
+srv_quit(int sig)
 {
-	/* traverse the soft pos's to emit trades */
-	for (size_t i = 0; i < pf->nposs; i++) {
-		pos_t p = pf->poss + i;
-
-		switch (p->ty) {
-		case POSTY_CASH: {
-			double d = p->cash.term.hard - p->cash.hard_ini;
-			double dfx = p->cash.forex;
-
-			if (d > 0.0) {
-				fprintf(whither, "CLEAR\t%.4f\t%s\n",
-					d, p->cash.hdr.sym);
-			} else if (d < 0.0) {
-				fprintf(whither, "CLEAR\t%.4f\t%s\n",
-					d, p->cash.hdr.sym);
-			}
-
-			if (dfx > 0.0) {
-				fprintf(whither, "BUY\t%.4f\t%s\n",
-					dfx, p->cash.tccy->sym);
-			} else if (dfx < 0.0) {
-				fprintf(whither, "SELL\t%.4f\t%s\n",
-					-dfx, p->cash.tccy->sym);
-			}
-			break;
-		}
-		case POSTY_FUT: {
-			if (p->fut.pos.soft > 0.0 &&
-			    p->fut.pos.hard < 0.0) {
-				fprintf(whither, "SHORT_BUY\t%.4f\t%s\n",
-					p->fut.pos.soft, p->fut.hdr.sym);
-			} else if (p->fut.pos.soft > 0.0) {
-				fprintf(whither, "BUY\t%.4f\t%s\n",
-					p->fut.pos.soft, p->fut.hdr.sym);
-			} else if (p->fut.pos.soft < 0.0 &&
-				   p->fut.pos.hard > 0.0) {
-				fprintf(whither, "SELL\t%.4f\t%s\n",
-					-p->fut.pos.soft, p->fut.hdr.sym);
-			} else if (p->fut.pos.soft < 0.0) {
-				fprintf(whither, "SHORT_SELL\t%.4f\t%s\n",
-					-p->fut.pos.soft, p->fut.hdr.sym);
-			}
-		}
-		default:
-			break;
-		}
-	}
+	(void)sig;
+	srv_quitp = 1;
 	return;
 }
 
-static void __attribute__((unused))
-fprint_info(pf_t pf, FILE *whither)
+static size_t
+srv_hash(const char *id)
 {
-	/* traverse the soft pos's to emit trades */
-	for (size_t i = 0; i < pf->nposs; i++) {
-		pos_t p = pf->poss + i;
-
-		switch (p->ty) {
-		case POSTY_CASH: {
-			double d = p->cash.term.soft - p->cash.soft_ini;
-			fprintf(whither, "INFO\t%.4f\t%s\n",
-				d, p->cash.hdr.sym);
-		}
-		default:
-			break;
-		}
+/* FNV-1a */
+	uint_fast64_t h = 0xcbf29ce484222325ULL;
+
+	for (; *id; id++) {
+		h ^= (unsigned char)*id;
+		h *= 0x100000001b3ULL;
 	}
-	return;
+	return (size_t)h;
 }
 
-static double
-reco_poss_ccy_s(pf_t pf, const_pfack_4217_t ccy)
+static durst_pf_t*
+srv_slot(durst_pf_t *pf, size_t zpf, const char *id)
 {
-/* go through all future positions and sum up their counter positions,
- * then find a cash position to book this to. */
-	double sum = 0.0;
-
-	for (size_t i = 0; i < pf->nposs; i++) {
-		pos_t p = pf->poss + i;
-
-		switch (p->ty) {
-		case POSTY_FUT:
-			if (p->fut.ccy->cod == ccy->cod) {
-				/* futures account for nothing */
-			}
-		default:
-			break;
+/* the slot of portfolio ID, or the free one it would go to */
+	for (size_t i = srv_hash(id) & (zpf - 1U);;
+	     i = (i + 1U) & (zpf - 1U)) {
+		if (pf[i] == NULL || !strcmp(durst_pf_id(pf[i]), id)) {
+			return pf + i;
 		}
 	}
-	return sum;
 }
 
-static double
-reco_poss_ccy_h(pf_t pf, const_pfack_4217_t ccy)
+static void
+srv_put(struct srv_s *s, durst_pf_t pf)
 {
-/* go through all future positions and sum up their counter positions,
- * then find a cash position to book this to. */
-	double sum = 0.0;
+	durst_pf_t *slot;
 
-	for (size_t i = 0; i < pf->nposs; i++) {
-		pos_t p = pf->poss + i;
+	/* keep the load below one half */
+	if (2U * (s->npf + 1U) > s->zpf) {
+		size_t nuz = s->zpf ? 2U * s->zpf : 64U;
+		durst_pf_t *nu = calloc(nuz, sizeof(*nu));
 
-		switch (p->ty) {
-		case POSTY_FUT:
-			if (p->fut.ccy->cod == ccy->cod) {
-				sum += p->fut.term.hard;
+		for (size_t i = 0; i < s->zpf; i++) {
+			if (s->pf[i] != NULL) {
+				*srv_slot(nu, nuz, durst_pf_id(s->pf[i])) =
+					s->pf[i];
 			}
-		default:
-			break;
 		}
+		free(s->pf);
+		s->pf = nu;
+		s->zpf = nuz;
+	}
+	if (*(slot = srv_slot(s->pf, s->zpf, durst_pf_id(pf))) != NULL) {
+		/* replace */
+		free_durst_pf(*slot);
+	} else {
+		s->npf++;
 	}
-	return sum;
+	*slot = pf;
+	return;
 }
 
 static void
-reco_poss_freeze(pf_t pf)
+srv_keep(struct srv_s *s, durst_pf_t pf)
 {
-/* go through all cash positions and gather any softs left over from
- * rebalancing, book it into the soft account of the cash position. */
-	for (size_t i = 0; i < pf->nposs; i++) {
-		pos_t p = pf->poss + i;
-		if (p->ty == POSTY_CASH && p->cash.tccy != NULL) {
-			p->cash.soft_ini = p->cash.term.soft;
-			p->cash.hard_ini = p->cash.term.hard;
-			p->cash.forex_ini = p->cash.forex;
-		}
+/* remember PF ready to be rebalanced, levers included */
+	durst_pf_set_base(s->b->ctx, pf, base_ccy);
+	if (s->b->argi->lever_given) {
+		durst_pf_lever(pf, s->b->argi->lever_arg);
 	}
+	durst_pf_keep(pf);
 	return;
 }
 
-static void
-reco_poss_thaw(pf_t pf)
+static durst_pf_t
+srv_get(struct srv_s *s, const char *id)
 {
-/* go through all cash positions and gather any softs left over from
- * rebalancing, book it into the soft account of the cash position. */
-	for (size_t i = 0; i < pf->nposs; i++) {
-		pos_t p = pf->poss + i;
-		if (p->ty == POSTY_CASH && p->cash.tccy != NULL) {
-			p->cash.term.soft = p->cash.soft_ini;
-			p->cash.term.hard = p->cash.hard_ini;
-			p->cash.forex = p->cash.forex_ini;
-		}
+	if (s->zpf == 0U) {
+		return NULL;
 	}
-	return;
+	return *srv_slot(s->pf, s->zpf, id);
 }
 
-static void
-reco_poss_reset(pf_t pf)
+static int
+srv_write(int fd, const void *p, size_t z)
 {
-	for (size_t i = 0; i < pf->nposs; i++) {
-		pos_t p = pf->poss + i;
-		if (p->ty == POSTY_CASH && p->cash.tccy != NULL) {
-			p->cash.term.soft = p->cash.soft_ini;
-			p->cash.term.hard = p->cash.hard_ini;
-			p->cash.forex = 0.0;
+	for (ssize_t nwr; z > 0U; p = (const char*)p + nwr, z -= nwr) {
+		if ((nwr = write(fd, p, z)) < 0 && errno != EINTR) {
+			return -1;
+		} else if (nwr < 0) {
+			nwr = 0;
 		}
 	}
-	return;
+	return 0;
 }
 
-static void __attribute__((unused))
-reco_poss(pf_t pf)
+static int
+srv_reply(struct conn_s *c, int st, const char *p, size_t z)
 {
-/* go through all cash positions and gather any softs left over from
- * rebalancing, book it into the soft account of the cash position. */
-	for (size_t i = 0; i < pf->nposs; i++) {
-		pos_t p = pf->poss + i;
-		if (p->ty == POSTY_CASH && p->cash.tccy != NULL) {
-			p->cash.term.soft += reco_poss_ccy_s(pf, p->cash.tccy);
-			p->cash.term.hard += reco_poss_ccy_h(pf, p->cash.tccy);
+	char hdr[32U];
+	size_t hz;
+
+	if (c->binp) {
+		/* status and payload length, uint32 little-endian each */
+		for (size_t i = 0; i < 4U; i++) {
+			hdr[i] = (char)((unsigned int)st >> (8U * i));
+			hdr[4U + i] = (char)((uint32_t)z >> (8U * i));
 		}
+		hz = 8U;
+	} else {
+		hz = snprintf(hdr, sizeof(hdr), "%s %zu\n",
+			      st == SRV_OK ? "OK" : "ERR", z);
 	}
-	return;
+	if (srv_write(c->wfd, hdr, hz) < 0 || srv_write(c->wfd, p, z) < 0) {
+		return -1;
+	}
+	return 0;
 }
 
-static void
-set_base_ccy_fut(pf_t pf, const_pfack_4217_t ccy, double val_fac)
+static int
+srv_load(struct srv_s *s, struct conn_s *c)
 {
-	for (size_t i = 0; i < pf->nposs; i++) {
-		pos_t p = pf->poss + i;
-		if (p->ty == POSTY_FUT && p->fut.ccy == ccy) {
-			p->fut.val_fac = val_fac;
+/* load the portfolios collected in C, replacing those by the same id */
+	static const char noid[] = "portfolio without id\n";
+	durst_ctx_t ctx = s->b->ctx;
+	durst_pf_t pf;
+	FILE *f;
+	int st = SRV_OK;
+
+	fclose(c->ld);
+	c->ld = NULL;
+	if ((f = fmemopen(c->lds, c->ldz, "r")) == NULL) {
+		free(c->lds);
+		return srv_reply(c, SRV_ERR, "", 0U);
+	}
+	while ((pf = durst_pf_read(ctx, f)) != NULL) {
+		if (durst_pf_id(pf) == NULL) {
+			free_durst_pf(pf);
+			st = SRV_ERR;
+			continue;
 		}
+		/* remember it as read, to start over for every request */
+		srv_keep(s, pf);
+		srv_put(s, pf);
+	}
+	fclose(f);
+	free(c->lds);
+	if (st != SRV_OK) {
+		return srv_reply(c, st, noid, sizeof(noid) - 1U);
 	}
-	return;	
+	return srv_reply(c, SRV_OK, "", 0U);
 }
 
-static void
-set_base_currency(pf_t pf, const_pfack_4217_t ccy)
+static int
+srv_quote(struct srv_s *s, struct conn_s *c, char *line, size_t z)
 {
-	urs_cash_pos_t bp;
-
-	/* start out by setting all CCY future position factors to 1.0 */
-	set_base_ccy_fut(pf, ccy, 1.0);
+	FILE *f;
+	int rc;
 
-	/* find the base currency cash position */
-	for (size_t i = 0; i < pf->nposs; i++) {
-		pos_t p = pf->poss + i;
-		if (p->ty == POSTY_CASH && p->cash.tccy == ccy) {
-			bp = &p->cash;
-			break;
-		}
+	if ((f = fmemopen(line, z, "r")) == NULL) {
+		return srv_reply(c, SRV_ERR, "", 0U);
 	}
+	rc = durst_read_quotes(s->b->ctx, f);
+	fclose(f);
+	return srv_reply(c, rc < 0 ? SRV_ERR : SRV_OK, "", 0U);
+}
 
-	/* find the currency in question, otherwise create a position */
-	for (size_t i = 0; i < pf->nposs; i++) {
-		pos_t p = pf->poss + i;
-		if (p->ty == POSTY_CASH && p->cash.tccy != ccy) {
-			set_base_ccy_fut(pf, p->cash.tccy, p->cash.s_mkt.stl);
-			p->cash.bp = bp;
-		}
+static int
+srv_run(struct srv_s *s, struct conn_s *c, const char *id, bool navp)
+{
+/* rebalance portfolio ID, or just value it, on the latest quotes */
+	static const char unk[] = "unknown portfolio\n";
+	static const char inc[] = "DATA INCOMPLETE\n";
+	/* levers have been applied when the portfolio was kept */
+	struct gengetopt_args_info argi = *s->b->argi;
+	durst_ctx_t ctx = s->b->ctx;
+	durst_pf_t pf;
+	FILE *out;
+	FILE *err;
+	char *os;
+	char *es;
+	size_t oz;
+	size_t ez;
+	int rc;
+
+	if ((pf = srv_get(s, id)) == NULL) {
+		return srv_reply(c, SRV_ERR, unk, sizeof(unk) - 1U);
+	}
+	durst_pf_reset(pf);
+	durst_pf_apply_quotes(ctx, pf);
+	if (!durst_pf_complete_p(pf)) {
+		return srv_reply(c, SRV_ERR, inc, sizeof(inc) - 1U);
 	}
 
-	/* to avoid confusion, we nil out all the stuff that has no ccy
-	 * val fac */
-	for (size_t i = 0; i < pf->nposs; i++) {
-		pos_t p = pf->poss + i;
-		if (p->ty == POSTY_FUT && p->fut.val_fac == 0.0) {
-			p->fut.band.lo =
-				p->fut.band.med =
-				p->fut.band.hi = 0.0;
-			p->fut.val_fac = -1.0;
-		}
+	out = open_memstream(&os, &oz);
+	err = open_memstream(&es, &ez);
+	if (s->b->argi->outfmt_arg == outfmt_arg_bin && !navp) {
+		/* every reply can be consumed on its own */
+		durst_emit_header(out, DURST_OUTFMT_BIN);
 	}
-	pf->bccy = ccy;
-	return;
+	argi.lever_given = 0;
+	__proc(ctx, pf, &argi, navp, out, err, NULL);
+	fclose(out);
+	fclose(err);
+	/* leave it as loaded, for CHECK requests */
+	durst_pf_reset(pf);
+	rc = srv_reply(c, SRV_OK, os, oz);
+	free(os);
+	free(es);
+	return rc;
 }
 
-static posty_t
-__parse_posty(const char *s)
+static int
+srv_check(struct srv_s *s, struct conn_s *c, const char *id)
 {
-	static const char c[] = "CASH";
-	static const char f[] = "FUT";
-	static const char fx[] = "FX";
-	static const char stk[] = "STK";
-	static const char nav[] = "NAV";
-
-	if (strncmp(s, c, sizeof(c) - 1) == 0) {
-		return POSTY_CASH;
-	} else if (strncmp(s, f, sizeof(f) - 1) == 0) {
-		return POSTY_FUT;
-	} else if (strncmp(s, fx, sizeof(fx) - 1) == 0) {
-		return POSTY_FX;
-	} else if (strncmp(s, stk, sizeof(stk) - 1) == 0) {
-		return POSTY_STK;
-	} else if (strncmp(s, nav, sizeof(nav) - 1) == 0) {
-		return POSTY_NAV;
-	}
-	return POSTY_UNK;
+/* revalue portfolio ID and count its band breaches, incrementally */
+	static const char unk[] = "unknown portfolio\n";
+	durst_pf_t pf;
+	char buf[256U];
+	size_t nbrk;
+	double nav;
+	int z;
+
+	if ((pf = srv_get(s, id)) == NULL) {
+		return srv_reply(c, SRV_ERR, unk, sizeof(unk) - 1U);
+	}
+	nbrk = durst_pf_update(s->b->ctx, pf, &nav);
+	z = snprintf(buf, sizeof(buf), "%s\tnav %.4f\tbreaches %zu\n",
+		     id, nav, nbrk);
+	return srv_reply(c, SRV_OK, buf,
+			 z >= 0 && z < (int)sizeof(buf) ? (size_t)z : 0U);
 }
 
 static const char*
-__skip_behind_tab(const char *s)
+srv_arg(char *line, const char *cmd)
 {
-	while (*s != '\0' && *s++ != '\t');
-	return s;
+/* if LINE is command CMD return its argument, or "" if there's none */
+	size_t z = strlen(cmd);
+
+	if (strncmp(line, cmd, z)) {
+		return NULL;
+	} else if (line[z] == '\0') {
+		return line + z;
+	} else if (line[z] != ' ' && line[z] != '\t') {
+		return NULL;
+	}
+	for (line += z; *line == ' ' || *line == '\t'; line++);
+	return line;
 }
 
-static const_pfack_4217_t
-__find_4217(const char *sym)
+static int
+srv_line(struct srv_s *s, struct conn_s *c, char *line, size_t z)
 {
-	for (size_t i = 0; i < countof(pfack_4217); i++) {
-		if (strncmp(sym, pfack_4217_sym(i), 3) == 0) {
-			return PFACK_4217(i);
+/* process one request line of Z bytes, sans the newline */
+	static const char bad[] = "bad request\n";
+	const char *a;
+
+	/* chop off line endings */
+	while (z > 0U && (line[z - 1U] == '\r' ||
+			  line[z - 1U] == ' ' || line[z - 1U] == '\t')) {
+		z--;
+	}
+	line[z] = '\0';
+
+	if (c->ld != NULL) {
+		if (!strcmp(line, "END")) {
+			return srv_load(s, c);
 		}
+		fprintf(c->ld, "%s\n", line);
+		return 0;
+	} else if ((a = srv_arg(line, "PORTFOLIO")) != NULL) {
+		c->ld = open_memstream(&c->lds, &c->ldz);
+		fprintf(c->ld, "%s\n", line);
+		return 0;
+	} else if ((a = srv_arg(line, "QUOTE")) != NULL) {
+		return srv_quote(s, c, line, z);
+	} else if ((a = srv_arg(line, "TRADES")) != NULL && *a) {
+		return srv_run(s, c, a, false);
+	} else if ((a = srv_arg(line, "NAV")) != NULL && *a) {
+		return srv_run(s, c, a, true);
+	} else if ((a = srv_arg(line, "CHECK")) != NULL && *a) {
+		return srv_check(s, c, a);
+	} else if ((a = srv_arg(line, "FRAMING")) != NULL &&
+		   (!strcmp(a, "text") || !strcmp(a, "bin"))) {
+		/* the reply still comes in the old framing */
+		int rc = srv_reply(c, SRV_OK, "", 0U);
+
+		c->binp = !strcmp(a, "bin");
+		return rc;
+	} else if (z == 0U) {
+		return 0;
+	}
+	return srv_reply(c, SRV_ERR, bad, sizeof(bad) - 1U);
+}
+
+static int
+srv_conn(struct srv_s *s, struct conn_s *c)
+{
+/* read what's there from C and process complete lines,
+ * return -1 when C is done with */
+	char *eol;
+	size_t off = 0U;
+	ssize_t nrd;
+
+	if (c->bufn + 4096U > c->bufz) {
+		c->bufz = c->bufz ? 2U * c->bufz : 16384U;
+		c->buf = realloc(c->buf, c->bufz);
+	}
+	if ((nrd = read(c->rfd, c->buf + c->bufn, c->bufz - c->bufn)) < 0) {
+		return errno == EINTR ? 0 : -1;
+	} else if (nrd == 0) {
+		return -1;
 	}
-	for (size_t j = 0; j < nmy4217; j++) {
-		if (strncmp(sym, my4217[j].sym, 3) == 0) {
-			return my4217 + j;
+	c->bufn += nrd;
+
+	while ((eol = memchr(c->buf + off, '\n', c->bufn - off)) != NULL) {
+		if (srv_line(s, c, c->buf + off, eol - (c->buf + off)) < 0) {
+			return -1;
 		}
+		off = eol + 1U - c->buf;
 	}
-	return NULL;
+	memmove(c->buf, c->buf + off, c->bufn -= off);
+	return 0;
 }
 
-static double
-read_tab_double(const char *s)
+static void
+srv_close(struct conn_s *c)
 {
-	if (*s == '\0' || *s == '\t') {
-		return 0.0;
+	if (c->ld != NULL) {
+		fclose(c->ld);
+		free(c->lds);
+	}
+	free(c->buf);
+	if (c->rfd > STDERR_FILENO) {
+		close(c->rfd);
 	}
-	return strtod(s, NULL);
+	return;
 }
 
 static int
-__parse_fut(urs_fut_pos_t fp, const char *line)
+srv_listen(const char *path)
 {
-/* FUT name ccy pos fbid fask fstl rbid rask rstl lo tgt hi fee */
-	const char *p;
-
-	p = __skip_behind_tab(line);
-
-	/* frob sym */
-	line = p;
-	p = __skip_behind_tab(line);
-	fp->hdr.sym = strndup(line, p - line - 1);
+	struct sockaddr_un sa = {.sun_family = AF_UNIX};
+	struct stat st;
+	int s;
 
-	/* frob ccy */
-	line = p;
-	p = __skip_behind_tab(line);
-	fp->ccy = __find_4217(line);
-
-	/* frob pos */
-	line = p;
-	if ((fp->mult = read_tab_double(line)) == 0.0) {
-		fp->mult = 1;
+	if (strlen(path) >= sizeof(sa.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
 	}
-
-	/* frob soft_pos */
-	line = __skip_behind_tab(p);
-	fp->pos.soft = read_tab_double(p = line);
-
-	/* frob hard_pos */
-	line = __skip_behind_tab(p);
-	fp->pos.hard = read_tab_double(p = line);
-
-	/* frob fbid */
-	line = __skip_behind_tab(p);
-	fp->f_mkt.bid = read_tab_double(p = line);
-
-	/* frob fask */
-	line = __skip_behind_tab(p);
-	fp->f_mkt.ask = read_tab_double(p = line);
-
-	/* frob fstl */
-	line = __skip_behind_tab(p);
-	fp->f_mkt.stl = read_tab_double(p = line);
-
-	/* frob sbid */
-	line = __skip_behind_tab(p);
-	fp->s_mkt.bid = read_tab_double(p = line);
-
-	/* frob sask */
-	line = __skip_behind_tab(p);
-	fp->s_mkt.ask = read_tab_double(p = line);
-
-	/* frob sstl */
-	line = __skip_behind_tab(p);
-	fp->s_mkt.stl = read_tab_double(p = line);
-
-	/* frob lo */
-	line = __skip_behind_tab(p);
-	fp->band.lo = read_tab_double(p = line);
-
-	/* frob tgt */
-	line = __skip_behind_tab(p);
-	fp->band.med = read_tab_double(p = line);
-
-	/* frob hi */
-	line = __skip_behind_tab(p);
-	fp->band.hi = read_tab_double(p = line);
-
-	/* convenience check */
-	if (fp->band.lo > fp->band.hi) {
-		double tmp = fp->band.lo;
-		fp->band.lo = fp->band.hi;
-		fp->band.hi = tmp;
+	strcpy(sa.sun_path, path);
+	/* a stale socket of ours is in the way otherwise */
+	if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+		unlink(path);
 	}
-
-	/* frob fee */
-	line = __skip_behind_tab(p);
-	fp->fee = read_tab_double(p = line);
-
-	return 0;
+	if ((s = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		return -1;
+	} else if (bind(s, (struct sockaddr*)&sa, sizeof(sa)) < 0 ||
+		   listen(s, 16) < 0) {
+		close(s);
+		return -1;
+	}
+	return s;
 }
 
 static int
-__parse_cash(urs_cash_pos_t cp, const char *line)
+serve(struct bat_s *b, const char *path)
 {
-/* CASH name soft_pos hard_pos bid ask stl lo med hi soft_fee hard_fee */
-	const char *p;
-
-	p = __skip_behind_tab(line);
-
-	/* frob sym */
-	line = p;
-	p = __skip_behind_tab(line);
-	cp->hdr.sym = strndup(line, p - line - 1);
-
-	/* frob ccy */
-	line = p;
-	p = __skip_behind_tab(line);
-	if ((cp->tccy = __find_4217(line)) == NULL) {
-		const_pfack_4217_t res = my4217 + nmy4217++;
-		memcpy((char*)res, line, 3);
-		*((char*)res + 3) = '\0';
-		cp->tccy = res;
+/* serve clients on unix socket PATH, or just stdin/stdout if it's - */
+	struct srv_s s = {.b = b};
+	struct sigaction sa = {.sa_handler = srv_quit};
+	struct pollfd *pfd = NULL;
+	struct conn_s *c = NULL;
+	size_t nc = 0U;
+	int ls;
+
+	signal(SIGPIPE, SIG_IGN);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	/* FILEs hold the portfolios to start out with */
+	for (unsigned int i = 0; i < b->argi->inputs_num; i++) {
+		durst_pf_t pf;
+		FILE *f;
+
+		if ((f = fopen(b->argi->inputs[i], "r")) == NULL) {
+			fprintf(stderr, "cannot open %s\n", b->argi->inputs[i]);
+			continue;
+		}
+		while ((pf = durst_pf_read(b->ctx, f)) != NULL) {
+			if (durst_pf_id(pf) == NULL) {
+				free_durst_pf(pf);
+				continue;
+			}
+			srv_keep(&s, pf);
+			srv_put(&s, pf);
+		}
+		fclose(f);
 	}
 
-	/* frob soft */
-	line = p;
-	cp->soft_ini = cp->term.soft = read_tab_double(p = line);
+	if (!strcmp(path, "-")) {
+		struct conn_s io = {.rfd = STDIN_FILENO, .wfd = STDOUT_FILENO};
 
-	/* frob hard */
-	line = __skip_behind_tab(p);
-	cp->hard_ini = cp->term.hard = read_tab_double(p = line);
-
-	/* set the fx slot for convenience */
-	cp->forex_ini = 0.0;
+		while (!srv_quitp && srv_conn(&s, &io) == 0);
+		srv_close(&io);
+		goto out;
+	} else if ((ls = srv_listen(path)) < 0) {
+		return -1;
+	}
 
-	/* frob bid */
-	line = __skip_behind_tab(p);
-	cp->s_mkt.bid = read_tab_double(p = line);
+	/* slot 0 is the listening socket, then one per connection */
+	pfd = malloc(sizeof(*pfd));
+	pfd[0] = (struct pollfd){.fd = ls, .events = POLLIN};
+	while (!srv_quitp) {
+		if (poll(pfd, nc + 1U, -1) < 0) {
+			continue;
+		}
+		for (size_t i = nc; i > 0U; i--) {
+			if (!pfd[i].revents || srv_conn(&s, c + i - 1U) == 0) {
+				continue;
+			}
+			/* hang up, move the last connection here */
+			srv_close(c + i - 1U);
+			c[i - 1U] = c[--nc];
+			pfd[i] = pfd[nc + 1U];
+		}
+		if (pfd[0].revents & POLLIN) {
+			int fd;
 
-	/* frob ask */
-	line = __skip_behind_tab(p);
-	cp->s_mkt.ask = read_tab_double(p = line);
+			if ((fd = accept(ls, NULL, NULL)) < 0) {
+				continue;
+			}
+			c = realloc(c, (nc + 1U) * sizeof(*c));
+			pfd = realloc(pfd, (nc + 2U) * sizeof(*pfd));
+			c[nc] = (struct conn_s){.rfd = fd, .wfd = fd};
+			pfd[++nc] = (struct pollfd){.fd = fd, .events = POLLIN};
+		}
+	}
+	for (size_t i = 0; i < nc; i++) {
+		srv_close(c + i);
+	}
+	free(c);
+	free(pfd);
+	close(ls);
+	unlink(path);
+out:
+	for (size_t i = 0; i < s.zpf; i++) {
+		if (s.pf[i] != NULL) {
+			free_durst_pf(s.pf[i]);
+		}
+	}
+	free(s.pf);
+	return 0;
+}
 
-	/* frob stl */
-	line = __skip_behind_tab(p);
-	cp->s_mkt.stl = read_tab_double(p = line);
+/* stream mode, portfolios are checked against their bands after every
+ * quote that comes in and rebalanced whenever a position leaves its
+ * band, all on the portfolios as they were read */
+struct strm_s {
+	struct bat_s *b;
+	size_t npf;
+	durst_pf_t *pf;
+	/* breaches of each portfolio as of the last tick */
+	size_t *nbrk;
+
+	/* tick latencies in ns */
+	size_t nlat;
+	size_t zlat;
+	uint64_t *lat;
+};
 
-	/* frob lo */
-	line = __skip_behind_tab(p);
-	cp->band.lo = read_tab_double(p = line);
+static uint64_t
+__now_ns(void)
+{
+	struct timespec ts;
 
-	/* frob tgt */
-	line = __skip_behind_tab(p);
-	cp->band.med = read_tab_double(p = line);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
 
-	/* frob hi */
-	line = __skip_behind_tab(p);
-	cp->band.hi = read_tab_double(p = line);
+static int
+__cmp_u64(const void *x, const void *y)
+{
+	const uint64_t a = *(const uint64_t*)x;
+	const uint64_t b = *(const uint64_t*)y;
 
-	/* frob soft fee */
-	line = __skip_behind_tab(p);
-	cp->soft_fee = read_tab_double(p = line);
+	return (a > b) - (a < b);
+}
 
-	/* frob fee */
-	line = __skip_behind_tab(p);
-	cp->hard_fee = read_tab_double(p = line);
+static void
+strm_add(struct strm_s *s, durst_pf_t pf)
+{
+	/* values and levers stay as they are for the whole stream */
+	durst_pf_set_base(s->b->ctx, pf, base_ccy);
+	if (s->b->argi->lever_given) {
+		durst_pf_lever(pf, s->b->argi->lever_arg);
+	}
+	durst_pf_keep(pf);
 
-	return 0;
+	s->pf = realloc(s->pf, (s->npf + 1U) * sizeof(*s->pf));
+	s->nbrk = realloc(s->nbrk, (s->npf + 1U) * sizeof(*s->nbrk));
+	s->pf[s->npf] = pf;
+	s->nbrk[s->npf++] = durst_pf_update(s->b->ctx, pf, NULL);
+	return;
 }
 
-static int
-__parse_nav(urs_nav_pos_t np, const char *line)
+static void
+strm_reba(struct strm_s *s, durst_pf_t pf)
 {
-/* CASH name soft_pos hard_pos bid ask stl lo med hi soft_fee hard_fee */
-	const char *p;
+	struct gengetopt_args_info argi = *s->b->argi;
+	durst_ctx_t ctx = s->b->ctx;
+
+	durst_pf_reset(pf);
+	durst_pf_apply_quotes(ctx, pf);
+	argi.lever_given = 0;
+	__proc(ctx, pf, &argi, false, stdout, stderr, NULL);
+	/* back to monitoring */
+	durst_pf_reset(pf);
+	return;
+}
 
-	p = __skip_behind_tab(line);
+static void
+strm_tick(struct strm_s *s)
+{
+	bool trdp = false;
 
-	/* frob sym, we just set it to NAV */
-	line = p;
-	np->hdr.sym = strdup("NAV");
+	for (size_t i = 0; i < s->npf; i++) {
+		size_t nbrk = durst_pf_update(s->b->ctx, s->pf[i], NULL);
 
-	/* frob ccy */
-	p = __skip_behind_tab(line);
-	if ((np->tccy = __find_4217(line)) == NULL) {
-		const_pfack_4217_t res = my4217 + nmy4217++;
-		memcpy((char*)res, line, 3);
-		*((char*)res + 3) = '\0';
-		np->tccy = res;
+		if (nbrk > s->nbrk[i]) {
+			/* something left its band */
+			strm_reba(s, s->pf[i]);
+			trdp = true;
+		}
+		s->nbrk[i] = nbrk;
 	}
+	if (trdp) {
+		fflush(stdout);
+	}
+	return;
+}
 
-	/* frob soft */
-	line = p;
-	np->soft_ini = np->base.soft = read_tab_double(p = line);
+static void
+strm_stats(const struct strm_s *s)
+{
+	static const double pct[] = {50.0, 90.0, 99.0, 99.9};
 
-	/* frob hard */
-	line = __skip_behind_tab(p);
-	np->hard_ini = np->base.hard = read_tab_double(p = line);
-	return 0;
+	if (s->nlat == 0U) {
+		fputs("ticks 0\n", stderr);
+		return;
+	}
+	qsort(s->lat, s->nlat, sizeof(*s->lat), __cmp_u64);
+	fprintf(stderr, "ticks %zu", s->nlat);
+	for (size_t i = 0; i < sizeof(pct) / sizeof(*pct); i++) {
+		/* nearest rank */
+		size_t k = (size_t)(pct[i] / 100.0 * (double)s->nlat + 0.999);
+
+		k = k > 0U ? k - 1U : 0U;
+		fprintf(stderr, "\tp%g %.3fus", pct[i], (double)s->lat[k] / 1e3);
+	}
+	fprintf(stderr, "\tmax %.3fus\n", (double)s->lat[s->nlat - 1U] / 1e3);
+	return;
 }
 
-static pf_t
-read_pf(FILE *whence)
+static int
+stream(struct bat_s *b, const char *path)
 {
-	pf_t res = NULL;
+/* monitor portfolios in FILEs against the quotes coming in on PATH,
+ * or stdin if it's - */
+	struct strm_s s = {.b = b};
+	struct sigaction sa = {.sa_handler = srv_quit};
+	FILE *qf;
 	char *line = NULL;
-	size_t len;
+	size_t llen = 0U;
+	ssize_t nrd;
 
-	/* read line by line */
-	if (whence == NULL) {
-		return NULL;
+	for (unsigned int i = 0; i < b->argi->inputs_num; i++) {
+		durst_pf_t pf;
+		FILE *f;
+
+		if ((f = fopen(b->argi->inputs[i], "r")) == NULL) {
+			fprintf(stderr, "cannot open %s\n", b->argi->inputs[i]);
+			continue;
+		}
+		while ((pf = durst_pf_read(b->ctx, f)) != NULL) {
+			strm_add(&s, pf);
+		}
+		fclose(f);
 	}
 
-	res = calloc(1, sizeof(*res) + 4 * sizeof(*res->poss));
+	if (!strcmp(path, "-")) {
+		qf = stdin;
+	} else if ((qf = fopen(path, "r")) == NULL) {
+		goto out;
+	}
+	/* no SA_RESTART, so a signal gets us out of a blocking read */
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
 
-	while (getline(&line, &len, whence) != -1) {
-		posty_t pty = __parse_posty(line);
-		pos_t p = res->poss + res->nposs;
+	while (!srv_quitp && (nrd = getline(&line, &llen, qf)) > 0) {
+		uint64_t t0 = __now_ns();
 
-		switch ((p->ty = pty)) {
-		case POSTY_CASH:
-			if (__parse_cash(&p->cash, line) == 0) {
-				res->nposs++;
-			}
-			break;
-		case POSTY_FUT:
-			if (__parse_fut(&p->fut, line) == 0) {
-				res->nposs++;
-			}
-			break;
-		case POSTY_NAV:
-			if (__parse_nav(&p->nav, line) == 0) {
-				res->nposs++;
-				res->val_ini.soft = p->nav.base.soft;
-				res->val_ini.hard = p->nav.base.hard;
-			}
-			break;
-		default:
-			break;
+		if (durst_read_quote(b->ctx, line, (size_t)nrd) < 0) {
+			continue;
 		}
+		strm_tick(&s);
 
-		/* check whether to resize */
-		if (res->nposs % 4 == 0) {
-			size_t old = res->nposs * sizeof(*res->poss);
-			size_t new = old + 4 * sizeof(*res->poss);
-
-			res = realloc(res, sizeof(*res) + new);
-			memset((char*)res + sizeof(*res) + old, 0, new - old);
+		if (s.nlat >= s.zlat) {
+			s.zlat = s.zlat ? 2U * s.zlat : 1024U;
+			s.lat = realloc(s.lat, s.zlat * sizeof(*s.lat));
 		}
+		s.lat[s.nlat++] = __now_ns() - t0;
 	}
 	free(line);
-	return res;
-}
-
-static int
-data_complete_p(pf_t pf)
-{
-/* check if for all non-0 positions we have market data */
-	for (size_t i = 0; i < pf->nposs; i++) {
-		pos_t p = pf->poss + i;
-		switch (p->ty) {
-		case POSTY_CASH:
-			if ((p->cash.term.soft != 0.0 ||
-			     p->cash.term.hard != 0.0) &&
-			    p->cash.s_mkt.stl == 0.0) {
-				return 0;
-			}
-			break;
-		case POSTY_FUT:
-			if ((p->fut.pos.soft != 0.0 ||
-			     p->fut.pos.hard != 0.0) &&
-			    p->fut.f_mkt.stl == 0.0) {
-				return 0;
-			}
-			break;
-		default:
-			break;
-		}
+	if (qf != stdin) {
+		fclose(qf);
 	}
-	return 1;
-}
-
-
-/* we need:
- * FUT name ccy pos fbid fask fstl rbid rask rstl lo tgt hi fee
- * CASH name ccy soft_pos hard_pos bid ask stl lo tgt hi soft_fee hard_fee
- */
-#if defined __INTEL_COMPILER
-# pragma warning (disable:593)
-#endif	/* __INTEL_COMPILER */
-#include "durst-clo.h"
-#include "durst-clo.c"
-#if defined __INTEL_COMPILER
-# pragma warning (default:593)
-#endif	/* __INTEL_COMPILER */
-
-static void
-__work(pf_t pf, enum enum_outfmt of)
-{
-	double new_nav = 0.0;
-	double old_nav;
-	size_t step = 0;
-	const size_t max_steps = 10;
-
-	URS_DEBUG("rebalancing ...\n");
-
-	reco_poss_freeze(pf);
-	/* cash assets constitute the nav as well, option? */
-	old_nav = new_nav = compute_pf_val(pf);
-	reco_poss_reset(pf);
-
-	do {
-		old_nav = new_nav;
-		reba_relanav(pf, old_nav);
-
-		reco_poss_freeze(pf);
-		/* cash assets constitute the nav as well, option? */
-		new_nav = compute_pf_val(pf);
-		reco_poss_reset(pf);
-
-		URS_DEBUG("OLD v NEW %.4f v %.4f\n", old_nav, new_nav);
-	} while (abs(old_nav - new_nav) > 0.01 && step++ < max_steps);
-
-	/* reconciliation, could be a CLI option */
-	reco_poss_thaw(pf);
-	/* now after thawing iterate over the portfolio to get the cash
-	 * balances right */
-	reba_relanav(pf, new_nav);
-	fprint_poss(pf, stderr);
-
-	/* print a list of trades so we can settle this crap */
-	switch (of) {
-	case outfmt_arg_csv:
-		fprint_trades(pf, stdout);
-		break;
-	case outfmt_arg_fixml:
-		fprint_trades_fixml(pf, stdout);
-		break;
-	default:
-		break;
-	}
-#if 0
-	/* for the moment we need info too */
-	fprint_info(pf, stdout);
-#endif
-	return;
+	strm_stats(&s);
+out:
+	for (size_t i = 0; i < s.npf; i++) {
+		free_durst_pf(s.pf[i]);
+	}
+	free(s.pf);
+	free(s.nbrk);
+	free(s.lat);
+	return qf != NULL ? 0 : -1;
 }
 
 int
 main(int argc, char *argv[])
 {
-	pf_t inpf;
 	struct gengetopt_args_info argi[1];
+	struct bat_s b = {
+		.argi = argi,
+		.mtx = PTHREAD_MUTEX_INITIALIZER,
+		.cnd = PTHREAD_COND_INITIALIZER,
+	};
+	long int nthr;
+	int res = 0;
 
 	/* parse command line and shite, preliminary */
 	if (cmdline_parser(argc, argv, argi)) {
 		exit(1);
 	}
 
-	inpf = read_pf(stdin);
-	/* establish base currency */
-	set_base_currency(inpf, PFACK_4217_EUR);
+	if ((nthr = argi->threads_arg) <= 0L) {
+		nthr = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if (nthr > 1L) {
+		b.pool = make_pool((unsigned int)nthr);
+		b.maxj = 64U * (size_t)nthr;
+	}
+	b.tail = &b.head;
+	b.ctx = make_durst_ctx();
+	if (argi->sum_arg == sum_arg_pairwise) {
+		durst_ctx_sum(b.ctx, DURST_SUM_PAIRWISE);
+	}
+	if (argi->model_arg != model_arg_roland) {
+		durst_ctx_model(b.ctx, DURST_MODEL_FEE_AWARE);
+	}
+	if (argi->split_arg <= 0) {
+		durst_ctx_split(b.ctx, sysconf(_SC_NPROCESSORS_ONLN));
+	} else if (argi->split_arg > 1) {
+		durst_ctx_split(b.ctx, argi->split_arg);
+	}
+	if (argi->outfmt_arg == outfmt_arg_bin && !argi->nav_only_given &&
+	    !argi->serve_given) {
+		durst_emit_header(stdout, DURST_OUTFMT_BIN);
+	}
 
-	/* adapt levers */
-	if (argi->lever_given) {
-		for (size_t i = 0; i < inpf->nposs; i++) {
-			if (inpf->poss[i].ty) {
-				inpf->poss[i].fut.band.lo *= argi->lever_arg;
-				inpf->poss[i].fut.band.med *= argi->lever_arg;
-				inpf->poss[i].fut.band.hi *= argi->lever_arg;
-			}
+	if (argi->write_snapshot_given &&
+	    (b.snap = durst_snap_create(
+		     b.ctx, argi->write_snapshot_arg)) == NULL) {
+		fprintf(stderr, "cannot create %s\n", argi->write_snapshot_arg);
+		res = 1;
+		goto out;
+	}
+	if (argi->state_given) {
+		FILE *f;
+
+		if ((f = fopen(argi->state_arg, "r")) == NULL ||
+		    durst_read_state(b.ctx, f) < 0) {
+			fprintf(stderr, "cannot load state %s\n",
+				argi->state_arg);
+		}
+		if (f != NULL) {
+			fclose(f);
 		}
 	}
+	if (argi->write_state_given &&
+	    (b.st = fopen(argi->write_state_arg, "w")) == NULL) {
+		fprintf(stderr, "cannot create %s\n", argi->write_state_arg);
+		res = 1;
+		goto out;
+	}
 
-	if (!data_complete_p(inpf)) {
-		/* just refuse to do stuff*/
-		fprintf(stderr, "DATA INCOMPLETE ... CUNT OFF\n");
-	} else if (argi->nav_only_given) {
-		fprint_poss(inpf, stdout);
-	} else {
-		__work(inpf, argi->outfmt_arg);
+	/* positions in FILEs go without quotes, they're joined from here */
+	if (argi->quotes_given) {
+		FILE *f;
+
+		if ((f = fopen(argi->quotes_arg, "r")) == NULL) {
+			fprintf(stderr, "cannot open %s\n", argi->quotes_arg);
+			res = 1;
+			goto out;
+		}
+		durst_read_quotes(b.ctx, f);
+		durst_ctx_join_quotes(b.ctx, 1);
+		fclose(f);
 	}
 
-	free_pf(inpf);
-	return 0;
+	if (argi->serve_given) {
+		if (serve(&b, argi->serve_arg) < 0) {
+			fprintf(stderr, "cannot serve on %s\n", argi->serve_arg);
+			res = 1;
+		}
+		goto out;
+	} else if (argi->stream_given) {
+		if (stream(&b, argi->stream_arg) < 0) {
+			fprintf(stderr, "cannot open %s\n", argi->stream_arg);
+			res = 1;
+		}
+		goto out;
+	}
+
+	/* with a snapshot, FILEs hold the day's quotes */
+	if (argi->inputs_num == 0U && argi->snapshot_given) {
+		durst_read_quotes(b.ctx, stdin);
+	} else if (argi->inputs_num == 0U) {
+		bat_read(&b, stdin);
+	}
+	for (unsigned int i = 0; i < argi->inputs_num; i++) {
+		FILE *f;
+
+		if ((f = fopen(argi->inputs[i], "r")) == NULL) {
+			bat_cannot(&b, "open", argi->inputs[i]);
+			res = 1;
+			continue;
+		} else if (argi->snapshot_given) {
+			durst_read_quotes(b.ctx, f);
+		} else {
+			bat_read(&b, f);
+		}
+		fclose(f);
+	}
+	if (argi->snapshot_given &&
+	    bat_read_snap(&b, argi->snapshot_arg) < 0) {
+		fprintf(stderr, "cannot load snapshot %s\n",
+			argi->snapshot_arg);
+		res = 1;
+	}
+	if (b.snap != NULL && durst_snap_close(b.snap) < 0) {
+		fprintf(stderr, "cannot write %s\n", argi->write_snapshot_arg);
+		res = 1;
+	}
+
+out:
+	if (b.pool != NULL) {
+		free_pool(b.pool);
+		bat_flush(&b, 0U);
+	}
+	if (b.st != NULL && fclose(b.st) != 0) {
+		fprintf(stderr, "cannot write %s\n", argi->write_state_arg);
+		res = 1;
+	}
+	free_durst_ctx(b.ctx);
+	cmdline_parser_free(argi);
+	return res;
 }
 
 /* durst.c ends here */
@@ -0,0 +1,289 @@
+/*** durst.h -- daily urs library
+ *
+ * LICENCE here
+ **/
+#if !defined INCLUDED_durst_h_
+#define INCLUDED_durst_h_
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#if !defined DECLF
+# define DECLF	extern
+# define DEFUN
+#endif	/* !DECLF */
+
+/**
+ * Everything a rebalancing session needs, in particular the table of
+ * custom (non-ISO) currencies met during parsing.
+ * Portfolios read through a context refer to it and must be freed
+ * before the context.  A context and its portfolios are not locked,
+ * different portfolios of one context may however be rebalanced and
+ * emitted concurrently once they have been read.  Reading adds to the
+ * custom currencies, so while portfolios are still being read, others
+ * may only be given ISO base currencies, see durst_pf_set_base(). */
+typedef struct durst_ctx_s *durst_ctx_t;
+
+/**
+ * A portfolio. */
+typedef struct durst_pf_s *durst_pf_t;
+
+typedef enum {
+	DURST_OUTFMT_CSV,
+	DURST_OUTFMT_FIXML,
+	DURST_OUTFMT_BIN,
+} durst_outfmt_t;
+
+/**
+ * How navs and the counter bookings of cash trades are added up, in
+ * input order, or in blocks of 512 positions in input order and the
+ * blocks' sums pairwise in a fixed tree.  Either way the bits don't
+ * depend on the number of threads or the vector width used. */
+typedef enum {
+	DURST_SUM_SERIAL,
+	DURST_SUM_PAIRWISE,
+} durst_sum_t;
+
+/**
+ * How futures are sized to their target weight, by their exposure in
+ * closed form (Roland's), or by Newton steps with the fee split among
+ * the positions by weight. */
+typedef enum {
+	DURST_MODEL_ROLAND,
+	DURST_MODEL_FEE_AWARE,
+} durst_model_t;
+
+/**
+ * Binary trades (DURST_OUTFMT_BIN) come as 32-byte records, all
+ * integers and doubles little-endian, the stream starts with a header:
+ *   0  char[8]  "DURSTBIN"
+ *   8  uint16   version, currently 1
+ *  10  uint16   record size, 32
+ *  12  ...      naught
+ * Records start with their type:
+ *   0  uint8    DURST_BIN_TRADE
+ *   1  uint8    side, a durst_bin_side_t
+ *   2  uint16   ISO 4217 code of the currency, 0 for custom ones
+ *   4  char[4]  currency symbol, nul padded, naught if unknown
+ *   8  uint32   portfolio id
+ *  12  uint32   symbol id, DURST_BIN_NOSYM for currency trades
+ *  16  double   quantity, as printed in the text formats
+ *  24  uint32   trade number within the portfolio, from 1
+ *  28  uint32   naught
+ * or, to name a portfolio or symbol id before it is first used:
+ *   0  uint8    DURST_BIN_PF or DURST_BIN_SYM
+ *   1  uint8    length of the name (capped at 255)
+ *   4  uint32   id
+ *   8  char[24] name, nul padded
+ * followed by DURST_BIN_CONT records for names longer than 24 bytes,
+ * carrying 24 more bytes each at offset 8.
+ * Symbol ids are unique within a context, portfolio ids count the
+ * portfolios read.  Names are repeated for every portfolio, so the
+ * output of each portfolio can be consumed on its own. */
+typedef enum {
+	DURST_BIN_TRADE = 1,
+	DURST_BIN_SYM = 2,
+	DURST_BIN_PF = 3,
+	DURST_BIN_CONT = 4,
+} durst_bin_typ_t;
+
+typedef enum {
+	DURST_BIN_BUY = 1,
+	DURST_BIN_SELL = 2,
+	DURST_BIN_SHORT_BUY = 3,
+	DURST_BIN_SHORT_SELL = 4,
+	DURST_BIN_CLEAR = 5,
+} durst_bin_side_t;
+
+#define DURST_BIN_NOSYM	(0xffffffffU)
+
+
+DECLF durst_ctx_t make_durst_ctx(void);
+DECLF void free_durst_ctx(durst_ctx_t);
+
+/**
+ * Read the next portfolio off WHENCE.
+ * Portfolios are delimited by `PORTFOLIO id' records, the first one
+ * may go without.  Return NULL when WHENCE is exhausted. */
+DECLF durst_pf_t durst_pf_read(durst_ctx_t, FILE *whence);
+
+DECLF void free_durst_pf(durst_pf_t);
+
+/**
+ * Return the id of PF as given by its PORTFOLIO record, or NULL. */
+DECLF const char *durst_pf_id(durst_pf_t pf);
+
+/**
+ * Establish currency CCY (an ISO 4217 symbol) as base currency of PF.
+ * Return -1 if CCY is unknown.  ISO currencies are looked up without
+ * going near the context's custom ones, anything else goes through
+ * the custom currencies' table and must not overlap with reading. */
+DECLF int durst_pf_set_base(durst_ctx_t, durst_pf_t pf, const char *ccy);
+
+/**
+ * Multiply all bands of PF by LEVER. */
+DECLF void durst_pf_lever(durst_pf_t pf, double lever);
+
+/**
+ * Have futures in PF be sized using MODEL, regardless of the context's,
+ * like a `MODEL roland|fee-aware' record in its input does. */
+DECLF void durst_pf_model(durst_pf_t pf, durst_model_t model);
+
+/**
+ * Return non-0 if PF has market data for all its non-0 positions. */
+DECLF int durst_pf_complete_p(durst_pf_t pf);
+
+/**
+ * Return the net asset value of PF in base currency units. */
+DECLF double durst_pf_nav(durst_pf_t pf);
+
+/**
+ * Rebalance PF so that all positions fall into their bands again.
+ * The base currency must have been set. */
+DECLF int durst_pf_rebalance(durst_pf_t pf);
+
+/**
+ * Return the number of rebalancing passes the last durst_pf_rebalance()
+ * of PF took, 0 if it hasn't been rebalanced or had all its positions
+ * in their bands, and put by how much its nav missed the fixed point
+ * into RESID if non-NULL. */
+DECLF size_t durst_pf_solve_stats(durst_pf_t pf, double *resid);
+
+/**
+ * Value PF and check its bands on the quotes of the moment, i.e. as
+ * if durst_pf_apply_quotes() had been called.  Only positions whose
+ * quotes were read since the last call, and futures valued at them,
+ * are looked at, unless the nav moved so much that other positions may
+ * change sides of their bands.  The nav is close to, but need not add
+ * up bitwise to, durst_pf_nav()'s.
+ * Return the number of positions outside their bands and put the nav
+ * into NAV if non-NULL.  PF must not have been rebalanced. */
+DECLF size_t durst_pf_update(durst_ctx_t, durst_pf_t pf, double *nav);
+
+/**
+ * Remember the positions of PF as they are, e.g. before rebalancing. */
+DECLF void durst_pf_keep(durst_pf_t pf);
+
+/**
+ * Take PF back to the positions remembered by durst_pf_keep(), so it
+ * can be rebalanced once more.  Quotes aren't touched by this, use
+ * durst_pf_apply_quotes() to pick up corrections.
+ * Return -1 if nothing has been remembered. */
+DECLF int durst_pf_reset(durst_pf_t pf);
+
+/**
+ * Print the positions and values of PF to WHITHER. */
+DECLF void durst_pf_emit_report(durst_pf_t pf, FILE *whither);
+
+/**
+ * Print trades that take PF to its rebalanced state in format OF. */
+DECLF void
+durst_pf_emit_trades(durst_pf_t pf, FILE *whither, durst_outfmt_t of);
+
+/**
+ * Print the state PF was left in by durst_pf_rebalance() to WHITHER,
+ * for warm starts later on:
+ *   PORTFOLIO id       unless PF goes without id
+ *   NAV nav passes last book
+ *                      the nav settled on, the passes it took, the nav
+ *                      of the last pass, and a digest of the book
+ *   FUT sym soft       future sym's soft position after the last pass,
+ *                      for those any pass resized */
+DECLF void durst_pf_emit_state(durst_pf_t pf, FILE *whither);
+
+/**
+ * Print what goes in front of the trades of all portfolios in format OF,
+ * i.e. the header of binary output. */
+DECLF void durst_emit_header(FILE *whither, durst_outfmt_t of);
+
+
+/**
+ * Snapshots hold portfolios as they are after reading and establishing
+ * the base currency, and are loaded with a single mmap and no parsing.
+ * A snapshot is only good for the build that wrote it. */
+typedef struct durst_snap_s *durst_snap_t;
+
+/**
+ * Start a snapshot in file FN, return NULL if it can't be created. */
+DECLF durst_snap_t durst_snap_create(durst_ctx_t, const char *fn);
+
+/**
+ * Add PF to snapshot S, PF's base currency must have been established
+ * and PF must not have been rebalanced. */
+DECLF int durst_snap_add(durst_snap_t s, durst_pf_t pf);
+
+/**
+ * Open snapshot file FN, return NULL if it's no snapshot of ours. */
+DECLF durst_snap_t durst_snap_open(durst_ctx_t, const char *fn);
+
+/**
+ * Return the next portfolio in S, or NULL when S is exhausted. */
+DECLF durst_pf_t durst_snap_read(durst_snap_t s);
+
+/**
+ * Finish a snapshot that is being written, or close one being read.
+ * Portfolios read off S remain valid. */
+DECLF int durst_snap_close(durst_snap_t s);
+
+/**
+ * Read `QUOTE sym bid ask stl' records off WHENCE into the context,
+ * other records are ignored.  Return -1 if there were no quotes.
+ * Quotes are held once per context and positions refer to them, a
+ * quote read again is corrected in place for all portfolios alike. */
+DECLF int durst_read_quotes(durst_ctx_t, FILE *whence);
+
+/**
+ * Read a single `QUOTE sym bid ask stl' record of length Z at LINE into
+ * the context, like durst_read_quotes() does.  Return -1 if LINE is no
+ * quote. */
+DECLF int durst_read_quote(durst_ctx_t, const char *line, size_t z);
+
+/**
+ * Have portfolios read from now on take their quotes from the ones read
+ * into the context, joined by symbol.  Position records then go without
+ * quotes, i.e.
+ *   FUT name ccy csize soft_pos hard_pos rb ra rs lo tgt hi fee
+ *   CASH name ccy soft_pos hard_pos lo tgt hi soft_fee hard_fee
+ * and positions without a quote yet are left with naught quotes. */
+DECLF void durst_ctx_join_quotes(durst_ctx_t, int joinp);
+
+/**
+ * Have navs of portfolios of the context be added up using SUM,
+ * DURST_SUM_SERIAL by default. */
+DECLF void durst_ctx_sum(durst_ctx_t, durst_sum_t sum);
+
+/**
+ * Have futures of portfolios of the context be sized using MODEL unless
+ * they come with a model of their own, DURST_MODEL_ROLAND by default. */
+DECLF void durst_ctx_model(durst_ctx_t, durst_model_t model);
+
+/**
+ * Rebalance portfolios of the context with a thousand positions or more
+ * on NTHREADS threads each, 1 to not split them.  Results are the same
+ * for any NTHREADS. */
+DECLF void durst_ctx_split(durst_ctx_t, unsigned int nthreads);
+
+/**
+ * Read the state of portfolios as left by durst_pf_emit_state() off
+ * WHENCE, rebalancing a portfolio with one of these ids redoes the last
+ * pass found there and if that yields the nav found there too, it's
+ * done, otherwise, e.g. when the book has changed, it starts cold.
+ * The trades are the same either way.  Not to be called while any
+ * portfolio of CTX is being rebalanced.  Return -1 if there was none. */
+DECLF int durst_read_state(durst_ctx_t, FILE *whence);
+
+/**
+ * Have the positions in PF refer to the quotes read into the context,
+ * futures to their future quotes, cash positions to their spot rates,
+ * and bring what's derived from them up to date.
+ * Call this again after quotes have been corrected. */
+DECLF void durst_pf_apply_quotes(durst_ctx_t, durst_pf_t pf);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* INCLUDED_durst_h_ */
@@ -0,0 +1,34 @@
+#!/usr/bin/awk -f
+### iso4217-idx.awk -- generate a direct index of the iso4217 table
+##
+## Reads iso4217.c and prints a C table mapping the 26^3 possible
+## upper-case symbols to 1-based indices into pfack_4217[], 0 for
+## symbols not in the list.  For symbols listed twice the first
+## occurrence wins, just like it did in a linear scan.
+
+BEGIN {
+	az = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+	n = 0;
+	print "/* generated from iso4217.c by iso4217-idx.awk, do not edit */";
+	print "static const uint16_t pfack_4217_idx[26U * 26U * 26U] = {";
+}
+
+/^[ \t]*\{"[A-Z][A-Z][A-Z]",/ {
+	sym = substr($0, index($0, "\"") + 1, 3);
+	key = (index(az, substr(sym, 1, 1)) - 1) * 676 + \
+		(index(az, substr(sym, 2, 1)) - 1) * 26 + \
+		(index(az, substr(sym, 3, 1)) - 1);
+	if (!(key in seen)) {
+		seen[key] = n;
+		printf "\t[%5d] = %3dU,\t/* %s */\n", key, n + 1, sym;
+	}
+	n++;
+}
+
+END {
+	print "};";
+	print "";
+	print "/* iso4217-idx.c ends here */";
+}
+
+## iso4217-idx.awk ends here
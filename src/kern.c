@@ -0,0 +1,316 @@
+/*** kern.c -- vectorised valuation and band check kernels
+ *
+ * LICENCE here
+ **/
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <string.h>
+#include "kern.h"
+
+#if defined __GNUC__ && defined HAVE_IMMINTRIN_H && \
+	(defined __x86_64__ || defined __i386__)
+# define KERN_X86
+# include <immintrin.h>
+#endif	/* x86 */
+
+/* all kernels do the same IEEE operations in the same order as the
+ * scalar code, so results are bit-identical whichever one is used */
+
+
+/* scalar versions, they also do the tails of the vector ones */
+static void
+__div_1(double *restrict r, const double *x, const double *y,
+	size_t i, size_t n)
+{
+	for (; i < n; i++) {
+		r[i] = x[i] / y[i];
+	}
+	return;
+}
+
+static void
+__cash_val_1(double *restrict vs, double *restrict vh,
+	     const double *soft, const double *fx, const double *hard,
+	     const double *stl, size_t i, size_t n)
+{
+	for (; i < n; i++) {
+		vs[i] = soft[i] / stl[i] + fx[i] / stl[i];
+		vh[i] = hard[i] / stl[i];
+	}
+	return;
+}
+
+static size_t
+__breach_1(uint64_t *restrict msk, const double *x, const double *stl,
+	   double nav, const double *lo, const double *hi,
+	   size_t i, size_t n)
+{
+	size_t res = 0U;
+
+	for (; i < n; i++) {
+		double r = x[i] / (nav * stl[i]);
+		uint64_t b = r < lo[i] || r > hi[i];
+
+		msk[i / 64U] |= b << (i % 64U);
+		res += b;
+	}
+	return res;
+}
+
+static void
+__div_scal(double *restrict r, const double *x, const double *y, size_t n)
+{
+	__div_1(r, x, y, 0U, n);
+	return;
+}
+
+static void
+__cash_val_scal(double *restrict vs, double *restrict vh,
+		const double *soft, const double *fx, const double *hard,
+		const double *stl, size_t n)
+{
+	__cash_val_1(vs, vh, soft, fx, hard, stl, 0U, n);
+	return;
+}
+
+static size_t
+__breach_scal(uint64_t *restrict msk, const double *x, const double *stl,
+	      double nav, const double *lo, const double *hi, size_t n)
+{
+	return __breach_1(msk, x, stl, nav, lo, hi, 0U, n);
+}
+
+
+#if defined KERN_X86
+/* vector widths are 2, 4 and 8, so lanes never straddle mask words */
+static void __attribute__((target("sse2")))
+__div_sse2(double *restrict r, const double *x, const double *y, size_t n)
+{
+	size_t i;
+
+	for (i = 0U; i + 2U <= n; i += 2U) {
+		__m128d q = _mm_div_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i));
+		_mm_storeu_pd(r + i, q);
+	}
+	__div_1(r, x, y, i, n);
+	return;
+}
+
+static void __attribute__((target("sse2")))
+__cash_val_sse2(double *restrict vs, double *restrict vh,
+		const double *soft, const double *fx, const double *hard,
+		const double *stl, size_t n)
+{
+	size_t i;
+
+	for (i = 0U; i + 2U <= n; i += 2U) {
+		__m128d s = _mm_loadu_pd(stl + i);
+		__m128d b_s = _mm_div_pd(_mm_loadu_pd(soft + i), s);
+		__m128d b_fx = _mm_div_pd(_mm_loadu_pd(fx + i), s);
+
+		_mm_storeu_pd(vs + i, _mm_add_pd(b_s, b_fx));
+		_mm_storeu_pd(vh + i, _mm_div_pd(_mm_loadu_pd(hard + i), s));
+	}
+	__cash_val_1(vs, vh, soft, fx, hard, stl, i, n);
+	return;
+}
+
+static size_t __attribute__((target("sse2")))
+__breach_sse2(uint64_t *restrict msk, const double *x, const double *stl,
+	      double nav, const double *lo, const double *hi, size_t n)
+{
+	const __m128d vnav = _mm_set1_pd(nav);
+	size_t res = 0U;
+	size_t i;
+
+	for (i = 0U; i + 2U <= n; i += 2U) {
+		__m128d tnav = _mm_mul_pd(vnav, _mm_loadu_pd(stl + i));
+		__m128d r = _mm_div_pd(_mm_loadu_pd(x + i), tnav);
+		__m128d b = _mm_or_pd(_mm_cmplt_pd(r, _mm_loadu_pd(lo + i)),
+				      _mm_cmpgt_pd(r, _mm_loadu_pd(hi + i)));
+		uint64_t m = (unsigned int)_mm_movemask_pd(b);
+
+		msk[i / 64U] |= m << (i % 64U);
+		res += __builtin_popcountll(m);
+	}
+	return res + __breach_1(msk, x, stl, nav, lo, hi, i, n);
+}
+
+static void __attribute__((target("avx2")))
+__div_avx2(double *restrict r, const double *x, const double *y, size_t n)
+{
+	size_t i;
+
+	for (i = 0U; i + 4U <= n; i += 4U) {
+		__m256d q = _mm256_div_pd(
+			_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i));
+		_mm256_storeu_pd(r + i, q);
+	}
+	__div_1(r, x, y, i, n);
+	return;
+}
+
+static void __attribute__((target("avx2")))
+__cash_val_avx2(double *restrict vs, double *restrict vh,
+		const double *soft, const double *fx, const double *hard,
+		const double *stl, size_t n)
+{
+	size_t i;
+
+	for (i = 0U; i + 4U <= n; i += 4U) {
+		__m256d s = _mm256_loadu_pd(stl + i);
+		__m256d b_s = _mm256_div_pd(_mm256_loadu_pd(soft + i), s);
+		__m256d b_fx = _mm256_div_pd(_mm256_loadu_pd(fx + i), s);
+		__m256d h = _mm256_div_pd(_mm256_loadu_pd(hard + i), s);
+
+		_mm256_storeu_pd(vs + i, _mm256_add_pd(b_s, b_fx));
+		_mm256_storeu_pd(vh + i, h);
+	}
+	__cash_val_1(vs, vh, soft, fx, hard, stl, i, n);
+	return;
+}
+
+static size_t __attribute__((target("avx2")))
+__breach_avx2(uint64_t *restrict msk, const double *x, const double *stl,
+	      double nav, const double *lo, const double *hi, size_t n)
+{
+	const __m256d vnav = _mm256_set1_pd(nav);
+	size_t res = 0U;
+	size_t i;
+
+	for (i = 0U; i + 4U <= n; i += 4U) {
+		__m256d tnav = _mm256_mul_pd(vnav, _mm256_loadu_pd(stl + i));
+		__m256d r = _mm256_div_pd(_mm256_loadu_pd(x + i), tnav);
+		__m256d blo = _mm256_cmp_pd(
+			r, _mm256_loadu_pd(lo + i), _CMP_LT_OQ);
+		__m256d bhi = _mm256_cmp_pd(
+			r, _mm256_loadu_pd(hi + i), _CMP_GT_OQ);
+		uint64_t m = (unsigned int)
+			_mm256_movemask_pd(_mm256_or_pd(blo, bhi));
+
+		msk[i / 64U] |= m << (i % 64U);
+		res += __builtin_popcountll(m);
+	}
+	return res + __breach_1(msk, x, stl, nav, lo, hi, i, n);
+}
+
+static void __attribute__((target("avx512f")))
+__div_avx512(double *restrict r, const double *x, const double *y, size_t n)
+{
+	size_t i;
+
+	for (i = 0U; i + 8U <= n; i += 8U) {
+		__m512d q = _mm512_div_pd(
+			_mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i));
+		_mm512_storeu_pd(r + i, q);
+	}
+	__div_1(r, x, y, i, n);
+	return;
+}
+
+static void __attribute__((target("avx512f")))
+__cash_val_avx512(double *restrict vs, double *restrict vh,
+		  const double *soft, const double *fx, const double *hard,
+		  const double *stl, size_t n)
+{
+	size_t i;
+
+	for (i = 0U; i + 8U <= n; i += 8U) {
+		__m512d s = _mm512_loadu_pd(stl + i);
+		__m512d b_s = _mm512_div_pd(_mm512_loadu_pd(soft + i), s);
+		__m512d b_fx = _mm512_div_pd(_mm512_loadu_pd(fx + i), s);
+		__m512d h = _mm512_div_pd(_mm512_loadu_pd(hard + i), s);
+
+		_mm512_storeu_pd(vs + i, _mm512_add_pd(b_s, b_fx));
+		_mm512_storeu_pd(vh + i, h);
+	}
+	__cash_val_1(vs, vh, soft, fx, hard, stl, i, n);
+	return;
+}
+
+static size_t __attribute__((target("avx512f")))
+__breach_avx512(uint64_t *restrict msk, const double *x, const double *stl,
+		double nav, const double *lo, const double *hi, size_t n)
+{
+	const __m512d vnav = _mm512_set1_pd(nav);
+	size_t res = 0U;
+	size_t i;
+
+	for (i = 0U; i + 8U <= n; i += 8U) {
+		__m512d tnav = _mm512_mul_pd(vnav, _mm512_loadu_pd(stl + i));
+		__m512d r = _mm512_div_pd(_mm512_loadu_pd(x + i), tnav);
+		__mmask8 blo = _mm512_cmp_pd_mask(
+			r, _mm512_loadu_pd(lo + i), _CMP_LT_OQ);
+		__mmask8 bhi = _mm512_cmp_pd_mask(
+			r, _mm512_loadu_pd(hi + i), _CMP_GT_OQ);
+		uint64_t m = (unsigned int)(blo | bhi);
+
+		msk[i / 64U] |= m << (i % 64U);
+		res += __builtin_popcountll(m);
+	}
+	return res + __breach_1(msk, x, stl, nav, lo, hi, i, n);
+}
+#endif	/* KERN_X86 */
+
+
+/* the kernels in use, resolved once at load time */
+static void(*div_f)(double *restrict, const double*, const double*, size_t) =
+	__div_scal;
+static void(*cash_val_f)(
+	double *restrict, double *restrict,
+	const double*, const double*, const double*, const double*, size_t) =
+	__cash_val_scal;
+static size_t(*breach_f)(
+	uint64_t *restrict, const double*, const double*, double,
+	const double*, const double*, size_t) =
+	__breach_scal;
+
+#if defined KERN_X86
+static void __attribute__((constructor))
+kern_init(void)
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		div_f = __div_avx512;
+		cash_val_f = __cash_val_avx512;
+		breach_f = __breach_avx512;
+	} else if (__builtin_cpu_supports("avx2")) {
+		div_f = __div_avx2;
+		cash_val_f = __cash_val_avx2;
+		breach_f = __breach_avx2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		div_f = __div_sse2;
+		cash_val_f = __cash_val_sse2;
+		breach_f = __breach_sse2;
+	}
+	return;
+}
+#endif	/* KERN_X86 */
+
+
+DEFUN void
+kern_div(double *r, const double *x, const double *y, size_t n)
+{
+	div_f(r, x, y, n);
+	return;
+}
+
+DEFUN void
+kern_cash_val(double *vs, double *vh,
+	      const double *soft, const double *fx, const double *hard,
+	      const double *stl, size_t n)
+{
+	cash_val_f(vs, vh, soft, fx, hard, stl, n);
+	return;
+}
+
+DEFUN size_t
+kern_breach(uint64_t *msk, const double *x, const double *stl, double nav,
+	    const double *lo, const double *hi, size_t n)
+{
+	memset(msk, 0, (n + 63U) / 64U * sizeof(*msk));
+	return breach_f(msk, x, stl, nav, lo, hi, n);
+}
+
+/* kern.c ends here */
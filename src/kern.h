@@ -0,0 +1,35 @@
+/*** kern.h -- vectorised valuation and band check kernels
+ *
+ * LICENCE here
+ **/
+#if !defined INCLUDED_kern_h_
+#define INCLUDED_kern_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if !defined DECLF
+# define DECLF	extern
+# define DEFUN
+#endif	/* !DECLF */
+
+/**
+ * Compute R[i] = X[i] / Y[i] for I in [0, N). */
+DECLF void kern_div(double *r, const double *x, const double *y, size_t n);
+
+/**
+ * Value N cash positions in base currency, i.e.
+ * VS[i] = SOFT[i] / STL[i] + FX[i] / STL[i] and VH[i] = HARD[i] / STL[i]. */
+DECLF void
+kern_cash_val(double *vs, double *vh,
+	      const double *soft, const double *fx, const double *hard,
+	      const double *stl, size_t n);
+
+/**
+ * Set bit I of MSK iff X[i] / (NAV * STL[i]) lies outside [LO[i], HI[i]].
+ * MSK must hold (N + 63) / 64 words, return the number of bits set. */
+DECLF size_t
+kern_breach(uint64_t *msk, const double *x, const double *stl, double nav,
+	    const double *lo, const double *hi, size_t n);
+
+#endif	/* INCLUDED_kern_h_ */
@@ -0,0 +1,4336 @@
+/*** libdurst.c -- the daily urs library
+ *
+ * LICENCE here
+ **/
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <locale.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "durst.h"
+#include "urs.h"
+#include "urs_fut.h"
+#include "urs_cash.h"
+#include "kern.h"
+#include "arena.h"
+#include "obuf.h"
+#include "team.h"
+
+#include "iso4217.h"
+#include "iso4217.c"
+#include "iso4217-idx.c"
+
+#if defined DEBUG_FLAG
+# define URS_DEBUG(args...)	fprintf(stderr, "[urs] " args);
+#else  /* !DEBUG_FLAG */
+# define URS_DEBUG(args...)
+#endif	/* DEBUG_FLAG */
+#if !defined UNUSED
+# define UNUSED(x)	__attribute__((unused)) x
+#endif	/* !UNUSED */
+
+#define countof(x)	(sizeof(x) / sizeof(*x))
+
+typedef struct pos_s *pos_t;
+typedef struct durst_pf_s *pf_t;
+
+typedef struct __nav_pos_s *urs_nav_pos_t;
+
+/* specific guys */
+struct fx_pos_s {
+	struct __hdr_s base;
+	struct __hdr_s term;
+
+	struct __mkt_s rate;
+};
+
+struct __nav_pos_s {
+	/* ident stuff */
+	struct __hdr_s hdr;
+
+	/* this currency */
+	const_pfack_4217_t tccy;
+
+	/* characteristics, track soft and hard positions,
+	 * we distinguish forex positions here as well because we must
+	 * not introduce instruments ourselves, as long as we don't do
+	 * FX positions anyway.
+	 * a forex long position would mean, buy the currency in question,
+	 * debitting the base currency position, short vice versa */
+	struct __val_s base;
+
+	double soft_ini;
+	double hard_ini;
+};
+
+typedef enum {
+	POSTY_UNK,
+	POSTY_FUT,
+	POSTY_CASH,
+	POSTY_FX,
+	POSTY_FXFW,
+	POSTY_STK,
+	POSTY_NAV,
+	POSTY_MODEL,
+} posty_t;
+
+/* positions live in type-homogeneous arrays, this is a handle in
+ * input order, for printing and the like */
+struct pos_s {
+	posty_t ty;
+	union {
+		urs_fut_pos_t fut;
+		urs_cash_pos_t cash;
+		/* slot in the type's array while reading */
+		size_t i;
+	};
+};
+
+/* hot fields of futures, mirrored from pf->fut by fut_col_put() */
+struct fut_col_s {
+	/* contracts, soft + hard */
+	double *pos;
+	double *lo;
+	double *hi;
+	/* rate of the cash position to book to, 0 if there's none */
+	double *stl;
+	double *val_fac;
+	/* cash effect in terms, and in base currency */
+	double *hard;
+	double *vh;
+
+	/* cash position to book to, see index_pf() */
+	urs_cash_pos_t *cp;
+	/* next future in the same currency */
+	size_t *nx;
+	/* band breaches, see reba_relanav_check() */
+	uint64_t *brk;
+	/* futures resized by the passes of __work() */
+	uint64_t *rsz;
+};
+
+/* hot fields of cash positions, mirrored by cash_col_put() */
+struct cash_col_s {
+	double *soft;
+	double *hard;
+	/* soft + hard */
+	double *pos;
+	double *fx;
+	double *stl;
+	/* band, -inf/inf if the position is not regarded as asset */
+	double *lo;
+	double *hi;
+	/* soft and forex, and hard value in base currency */
+	double *vs;
+	double *vh;
+
+	/* band breaches, see reba_relanav_check() */
+	uint64_t *brk;
+	/* positions without band, they're rebalanced whenever anything is */
+	uint64_t *free;
+	/* positions with forex booked in this pass, and in the one before,
+	 * the worklist of reco_poss_settle() */
+	uint64_t *tch;
+	uint64_t *wl;
+	/* counter bookings by block, or by position, see reba_relanav() */
+	double *bk;
+	double *bkp;
+};
+
+#define NOFUT	((size_t)-1)
+
+/* portfolios are rebalanced in blocks of this many futures or cash
+ * positions, blocks start on word boundaries of the masks so no two of
+ * them share a word, see pf_team() */
+#define SPLIT_BLK	(512U)
+
+struct durst_pf_s {
+	/* everything below lives in here, see read_pf() */
+	arena_t arena;
+	durst_ctx_t ctx;
+	/* input mapping symbols may point into, or NULL */
+	struct map_s *map;
+
+	/* hard */
+	struct __val_s val;
+	struct __val_s val_ini;
+	const_pfack_4217_t bccy;
+	/* portfolio id as given by a PORTFOLIO record, or NULL */
+	char *id;
+	/* futures model as given by a MODEL record, -1 for the context's */
+	int model;
+	/* number of the portfolio within its context */
+	uint32_t seq;
+	/* symbol ids used by this portfolio are below nsym */
+	uint32_t nsym;
+
+	/* positions by currency, open-addressed, zgrp is a power of 2 */
+	size_t zgrp;
+	struct ccy_grp_s *grp;
+
+	size_t nfut;
+	size_t zfut;
+	struct __fut_pos_s *fut;
+	struct fut_col_s fc;
+
+	size_t ncash;
+	size_t zcash;
+	struct __cash_pos_s *cash;
+	struct cash_col_s cc;
+
+	/* all positions in input order */
+	size_t nposs;
+	size_t zposs;
+	struct pos_s *poss;
+	/* their hard values, so the nav adds up in input order */
+	const double **hord;
+	/* sums by block, see compute_pf_val() */
+	double *psum;
+	/* interned market data held by positions */
+	size_t nmref;
+	size_t zmref;
+	struct mkt_s **mref;
+
+	/* positions as remembered by durst_pf_keep(), or NULL */
+	struct __fut_pos_s *fut0;
+	struct __cash_pos_s *cash0;
+	const_pfack_4217_t bccy0;
+
+	/* rebalancing passes taken by the last durst_pf_rebalance(), 0 if
+	 * not rebalanced, by how much the nav missed its fixed point, and
+	 * the nav settled on */
+	size_t niter;
+	double resid;
+	double nav_fix;
+	/* the nav the last pass was rebalanced at, and the digest of the
+	 * book it all started from, see book_digest() */
+	double nav_try;
+	uint_fast64_t book;
+	/* soft positions of futures after the last pass, NaN for those no
+	 * pass resized, see __work(), and the same as of the warm start */
+	double *lfut;
+	double *wfut;
+	/* the book while a warm start is tried, see warm_replay() */
+	struct __fut_pos_s *fut1;
+	struct __cash_pos_s *cash1;
+
+	/* incremental valuation, see durst_pf_update(), valid if incp,
+	 * quotes are accounted for up to qlog of the context's quote log,
+	 * counting from its very first entry */
+	bool incp;
+	size_t qlog;
+	size_t nbrk;
+	/* nav of the last full band check, and the range of nav_ref / nav
+	 * within which no band breach is gained or lost */
+	double nav_ref;
+	double qlo;
+	double qhi;
+	/* positions by symbol id, open-addressed, zsix is a power of 2,
+	 * and room for the positions touched by an update */
+	size_t zsix;
+	struct six_s *six;
+	size_t *dirt;
+};
+
+struct six_s {
+	/* symbol id + 1, 0 for free slots */
+	uint32_t id1;
+	/* the position in poss */
+	uint32_t k;
+};
+
+/* how a portfolio came out of the last run, see durst_read_state() */
+struct wst_s {
+	const char *id;
+	size_t idz;
+	uint_fast64_t h;
+	/* the nav settled on, the one of the last pass, and the digest of
+	 * the book, see durst_pf_emit_state() */
+	double nav;
+	double nav_try;
+	uint_fast64_t book;
+	/* soft positions of futures after the last pass by symbol id */
+	size_t nfut;
+	size_t zfut;
+	uint32_t *fsym;
+	double *fsoft;
+};
+
+struct ccy_grp_s {
+	const_pfack_4217_t ccy;
+	/* the first cash position in this currency, and the last one
+	 * whose rate is used to value futures */
+	urs_cash_pos_t cash;
+	urs_cash_pos_t last;
+	/* the futures in this currency, chained through fc.nx */
+	size_t fut;
+	size_t *fut_tail;
+};
+
+/* a mapped input file, shared by the reader and the portfolios whose
+ * symbols point into it */
+struct map_s {
+	const char *p;
+	size_t z;
+	size_t nref;
+};
+
+/* input state, so that several portfolios can be read off one stream */
+struct rdr_s {
+	FILE *whence;
+	char *line;
+	size_t llen;
+	/* the mapped input, if WHENCE is a regular file, and our cursor */
+	struct map_s *map;
+	const char *mp;
+	const char *me;
+	/* id of the portfolio to come, if announced by a PORTFOLIO record */
+	char *nid;
+	size_t znid;
+	bool nidp;
+	/* number of portfolios read so far */
+	size_t npf;
+};
+
+struct durst_ctx_s {
+	struct rdr_s rdr;
+
+	/* custom currencies, i.e. those not in the iso4217 list,
+	 * open-addressed by their packed symbol, zmy4217 is a power of 2 */
+	size_t nmy4217;
+	size_t zmy4217;
+	const_pfack_4217_t *my4217;
+	/* their storage, in blocks so pointers to them remain valid */
+	struct my4217_blk_s *my4217_blk;
+
+	/* arenas of freed portfolios, for reuse, guarded by amtx as
+	 * portfolios may be freed concurrently */
+	pthread_mutex_t amtx;
+	size_t narena;
+	size_t zarena;
+	arena_t *arena;
+
+	/* interned symbols, ids are handed out in order of appearance,
+	 * symh holds ids + 1 open-addressed by hash, zsymh is a power of 2,
+	 * like the portfolio count they're only touched while reading */
+	uint32_t nsym;
+	size_t zsym;
+	struct sym_s *sym;
+	size_t zsymh;
+	uint32_t *symh;
+	arena_t sarena;
+	uint32_t npf;
+
+	/* market data shared by all portfolios, positions point into
+	 * marena; quotes given along with positions are interned by value,
+	 * mkth holds ordinals + 1 open-addressed by hash, zmkth is a power
+	 * of 2, like symbols they're only touched while reading, except
+	 * for the reference counts, records nobody holds are swept off
+	 * mkth when it fills up and reused from mfree */
+	uint32_t nmkt;
+	size_t zmkt;
+	struct mkt_s **mkt;
+	size_t nmkth;
+	size_t zmkth;
+	uint32_t *mkth;
+	size_t nmfree;
+	uint32_t *mfree;
+	arena_t marena;
+
+	/* quotes by symbol id, see durst_read_quotes(), unlike the ones
+	 * above they're updated in place */
+	size_t zquo;
+	struct quo_s *quo;
+	/* whether positions go without quotes and use the ones above */
+	bool qjoin;
+	/* how navs are added up */
+	durst_sum_t sum;
+	/* how futures are sized unless portfolios say otherwise */
+	durst_model_t model;
+	/* big portfolios are rebalanced in blocks on here, or NULL */
+	team_t team;
+	/* symbol ids of quotes in the order they came in, see
+	 * durst_pf_update(), qlog[0] is entry qbase of the whole log,
+	 * the log is emptied once none of the ninc portfolios valued
+	 * incrementally lags behind, nlag of them do */
+	size_t qbase;
+	size_t nqlog;
+	size_t zqlog;
+	uint32_t *qlog;
+	size_t ninc;
+	size_t nlag;
+
+	/* warm starts by portfolio id, wsth holds indices + 1
+	 * open-addressed by hash, zwsth is a power of 2 */
+	size_t nwst;
+	size_t zwst;
+	struct wst_s *wst;
+	size_t zwsth;
+	uint32_t *wsth;
+};
+
+struct quo_s {
+	struct __mkt_s *mkt;
+	bool setp;
+};
+
+/* interned market data, held by the portfolios and snapshots that
+ * point to it, see __intern_mkt() */
+struct mkt_s {
+	struct __mkt_s m;
+	uint32_t nref;
+};
+
+static inline void
+__drop_mkt(struct mkt_s *r)
+{
+/* portfolios may be freed on any thread, the record is only looked at
+ * again on the reading one, see __rehash_mkt() */
+	__atomic_sub_fetch(&r->nref, 1U, __ATOMIC_RELEASE);
+	return;
+}
+
+struct sym_s {
+	const char *s;
+	size_t z;
+	uint_fast64_t h;
+};
+
+struct my4217_blk_s {
+	struct my4217_blk_s *next;
+	size_t n;
+	struct pfack_4217_s c[32U];
+};
+
+
+/* posty specific accessors */
+static double
+pos_soft(pos_t p)
+{
+	switch (p->ty) {
+	case POSTY_FUT:
+		return p->fut->pos.soft;
+	case POSTY_CASH:
+		return p->cash->term.soft;
+	default:
+		return 0.0;
+	}
+}
+
+static double
+pos_hard(pos_t p)
+{
+	switch (p->ty) {
+	case POSTY_FUT:
+		return p->fut->pos.hard;
+	case POSTY_CASH:
+		return p->cash->term.hard;
+	default:
+		return 0.0;
+	}
+}
+
+static inline void
+fut_col_put(pf_t pf, size_t i)
+{
+	const struct __fut_pos_s *fp = pf->fut + i;
+	urs_cash_pos_t cp = pf->fc.cp[i];
+
+	pf->fc.pos[i] = fp->pos.soft + fp->pos.hard;
+	pf->fc.lo[i] = fp->band.lo;
+	pf->fc.hi[i] = fp->band.hi;
+	pf->fc.stl[i] = cp ? cp->s_mkt->stl : 0.0;
+	pf->fc.val_fac[i] = fp->val_fac;
+	pf->fc.hard[i] = fp->term.hard;
+	return;
+}
+
+static inline void
+cash_col_put(pf_t pf, size_t i)
+{
+	const struct __cash_pos_s *cp = pf->cash + i;
+
+	pf->cc.soft[i] = cp->term.soft;
+	pf->cc.hard[i] = cp->term.hard;
+	pf->cc.pos[i] = cp->term.soft + cp->term.hard;
+	pf->cc.fx[i] = cp->forex;
+	pf->cc.stl[i] = cp->s_mkt->stl;
+	if (cp->band.lo < 0.0 || cp->band.hi < 0.0) {
+		pf->cc.lo[i] = -INFINITY;
+		pf->cc.hi[i] = INFINITY;
+		pf->cc.free[i / 64U] |= 1ULL << (i % 64U);
+	} else {
+		pf->cc.lo[i] = cp->band.lo;
+		pf->cc.hi[i] = cp->band.hi;
+		pf->cc.free[i / 64U] &= ~(1ULL << (i % 64U));
+	}
+	return;
+}
+
+static void
+cols_put(pf_t pf)
+{
+	for (size_t i = 0; i < pf->nfut; i++) {
+		fut_col_put(pf, i);
+	}
+	for (size_t i = 0; i < pf->ncash; i++) {
+		cash_col_put(pf, i);
+	}
+	return;
+}
+
+static inline team_t
+pf_team(pf_t pf)
+{
+/* the team to share PF's blocks out to, small books stay with us */
+	if (pf->nfut + pf->ncash < 2U * SPLIT_BLK) {
+		return NULL;
+	}
+	return pf->ctx->team;
+}
+
+static void
+__val_blk(void *clo, size_t k)
+{
+/* the per position part of compute_pf_val(), blocks of futures first,
+ * then blocks of cash positions */
+	pf_t pf = clo;
+	const struct fut_col_s *fc = &pf->fc;
+	const struct cash_col_s *cc = &pf->cc;
+	const size_t nbf = (pf->nfut + SPLIT_BLK - 1U) / SPLIT_BLK;
+	size_t lo, hi;
+
+	if (k < nbf) {
+		lo = k * SPLIT_BLK;
+		hi = lo + SPLIT_BLK < pf->nfut ? lo + SPLIT_BLK : pf->nfut;
+
+		/* futures account for their cash effects only */
+		for (size_t i = lo; i < hi; i++) {
+			pf->fut[i].term.soft = 0.0;
+		}
+		kern_div(fc->vh + lo, fc->hard + lo, fc->val_fac + lo, hi - lo);
+	} else if (pf->val_ini.hard == 0.0) {
+		lo = (k - nbf) * SPLIT_BLK;
+		hi = lo + SPLIT_BLK < pf->ncash ? lo + SPLIT_BLK : pf->ncash;
+
+		kern_cash_val(cc->vs + lo, cc->vh + lo,
+			      cc->soft + lo, cc->fx + lo, cc->hard + lo,
+			      cc->stl + lo, hi - lo);
+	}
+	return;
+}
+
+static double
+__pw_sum(const double *x, size_t n)
+{
+/* pairwise sum of X, the tree only depends on N */
+	if (n == 0U) {
+		return 0.0;
+	} else if (n == 1U) {
+		return x[0U];
+	}
+	return __pw_sum(x, n / 2U) + __pw_sum(x + n / 2U, n - n / 2U);
+}
+
+static void
+__sum_blk(void *clo, size_t k)
+{
+/* block sums for DURST_SUM_PAIRWISE, blocks of hard values in input
+ * order, then blocks of soft values, or with a hard-set nav blocks of
+ * the futures' hard values */
+	pf_t pf = clo;
+	const size_t nbh = (pf->nposs + SPLIT_BLK - 1U) / SPLIT_BLK;
+	size_t lo = k * SPLIT_BLK;
+	size_t hi;
+	double s = 0.0;
+
+	if (pf->val_ini.hard != 0.0) {
+		hi = lo + SPLIT_BLK < pf->nfut ? lo + SPLIT_BLK : pf->nfut;
+		for (size_t i = lo; i < hi; i++) {
+			s += pf->fc.vh[i];
+		}
+	} else if (k < nbh) {
+		hi = lo + SPLIT_BLK < pf->nposs ? lo + SPLIT_BLK : pf->nposs;
+		for (size_t i = lo; i < hi; i++) {
+			s += *pf->hord[i];
+		}
+	} else {
+		lo = (k - nbh) * SPLIT_BLK;
+		hi = lo + SPLIT_BLK < pf->ncash ? lo + SPLIT_BLK : pf->ncash;
+		for (size_t i = lo; i < hi; i++) {
+			s += pf->cc.vs[i];
+		}
+	}
+	pf->psum[k] = s;
+	return;
+}
+
+static double
+compute_pf_val(pf_t pf)
+{
+	const struct fut_col_s *fc = &pf->fc;
+	const struct cash_col_s *cc = &pf->cc;
+	const size_t nbf = (pf->nfut + SPLIT_BLK - 1U) / SPLIT_BLK;
+	const size_t nbc = (pf->ncash + SPLIT_BLK - 1U) / SPLIT_BLK;
+
+	pf->val = pf->val_ini;
+
+	team_run(pf_team(pf), __val_blk, pf, nbf + nbc);
+
+	if (pf->ctx->sum == DURST_SUM_PAIRWISE && pf->val_ini.hard != 0.0) {
+		team_run(pf_team(pf), __sum_blk, pf, nbf);
+		pf->val.hard += __pw_sum(pf->psum, nbf);
+		goto out;
+	} else if (pf->ctx->sum == DURST_SUM_PAIRWISE) {
+		const size_t nbh = (pf->nposs + SPLIT_BLK - 1U) / SPLIT_BLK;
+
+		team_run(pf_team(pf), __sum_blk, pf, nbh + nbc);
+		pf->val.soft += __pw_sum(pf->psum + nbh, nbc);
+		pf->val.hard += __pw_sum(pf->psum, nbh);
+		goto out;
+	} else if (pf->val_ini.hard != 0.0) {
+		/* only add cash up if the portfolio hasn't
+		 * had a hard-set NAV */
+		for (size_t i = 0; i < pf->nfut; i++) {
+			pf->val.hard += fc->vh[i];
+		}
+		goto out;
+	}
+
+	/* the sums themselves go in input order */
+	for (size_t i = 0; i < pf->ncash; i++) {
+		pf->val.soft += cc->vs[i];
+	}
+	for (size_t i = 0; i < pf->nposs; i++) {
+		pf->val.hard += *pf->hord[i];
+	}
+out:
+	URS_DEBUG("pf_val() soft %.6f hard %.6f\n", pf->val.soft, pf->val.hard);
+	return pf->val.soft + pf->val.hard;
+}
+
+static struct ccy_grp_s*
+find_ccy_grp(pf_t pf, const_pfack_4217_t ccy)
+{
+	if (pf->zgrp == 0U || ccy == NULL) {
+		return NULL;
+	}
+	for (size_t i = ((uintptr_t)ccy / sizeof(*ccy)) & (pf->zgrp - 1U);;
+	     i = (i + 1U) & (pf->zgrp - 1U)) {
+		if (pf->grp[i].ccy == ccy) {
+			return pf->grp + i;
+		} else if (pf->grp[i].ccy == NULL) {
+			return NULL;
+		}
+	}
+}
+
+static urs_cash_pos_t
+find_cash_pos(pf_t pf, pos_t pos)
+{
+	switch (pos->ty) {
+	case POSTY_CASH:
+		return pos->cash;
+	case POSTY_FUT:
+		return pf->fc.cp[pos->fut - pf->fut];
+	default:
+		return NULL;
+	}
+}
+
+static void
+index_pf(pf_t pf)
+{
+/* set up the columns and group positions by currency, so we can find
+ * the cash position to book futures to, or all futures in a currency,
+ * in constant time */
+	const size_t nf = pf->nfut;
+	const size_t nc = pf->ncash;
+	double *fcol = arena_calloc(pf->arena, 7U * nf + 1U, sizeof(*fcol));
+	double *ccol = arena_calloc(pf->arena, 9U * nc + 1U, sizeof(*ccol));
+
+	pf->fc.pos = fcol;
+	pf->fc.lo = fcol + nf;
+	pf->fc.hi = fcol + 2U * nf;
+	pf->fc.stl = fcol + 3U * nf;
+	pf->fc.val_fac = fcol + 4U * nf;
+	pf->fc.hard = fcol + 5U * nf;
+	pf->fc.vh = fcol + 6U * nf;
+	pf->fc.cp = arena_calloc(pf->arena, nf + 1U, sizeof(*pf->fc.cp));
+	pf->fc.nx = arena_calloc(pf->arena, nf + 1U, sizeof(*pf->fc.nx));
+	pf->fc.brk = arena_calloc(pf->arena, nf / 64U + 1U, sizeof(uint64_t));
+	pf->fc.rsz = arena_calloc(pf->arena, nf / 64U + 1U, sizeof(uint64_t));
+
+	pf->cc.soft = ccol;
+	pf->cc.hard = ccol + nc;
+	pf->cc.pos = ccol + 2U * nc;
+	pf->cc.fx = ccol + 3U * nc;
+	pf->cc.stl = ccol + 4U * nc;
+	pf->cc.lo = ccol + 5U * nc;
+	pf->cc.hi = ccol + 6U * nc;
+	pf->cc.vs = ccol + 7U * nc;
+	pf->cc.vh = ccol + 8U * nc;
+	pf->cc.brk = arena_calloc(pf->arena, nc / 64U + 1U, sizeof(uint64_t));
+	pf->cc.free = arena_calloc(pf->arena, nc / 64U + 1U, sizeof(uint64_t));
+	pf->cc.tch = arena_calloc(pf->arena, nc / 64U + 1U, sizeof(uint64_t));
+	pf->cc.wl = arena_calloc(pf->arena, nc / 64U + 1U, sizeof(uint64_t));
+	pf->cc.bk = arena_calloc(pf->arena, nc / SPLIT_BLK + 1U, sizeof(double));
+	pf->cc.bkp = arena_calloc(pf->arena, nc + 1U, sizeof(double));
+
+	/* the arrays won't move any more, resolve the handles */
+	pf->hord = arena_calloc(pf->arena, pf->nposs + 1U, sizeof(*pf->hord));
+	pf->psum = arena_calloc(
+		pf->arena, (pf->nposs + nc + nf) / SPLIT_BLK + 3U,
+		sizeof(*pf->psum));
+	for (size_t i = 0; i < pf->nposs; i++) {
+		pos_t p = pf->poss + i;
+
+		switch (p->ty) {
+		case POSTY_FUT:
+			pf->hord[i] = pf->fc.vh + p->i;
+			p->fut = pf->fut + p->i;
+			break;
+		case POSTY_CASH:
+			pf->hord[i] = pf->cc.vh + p->i;
+			p->cash = pf->cash + p->i;
+			break;
+		default:
+			break;
+		}
+	}
+
+	for (pf->zgrp = 16U; pf->zgrp < 2U * (nf + nc); pf->zgrp *= 2U);
+	pf->grp = arena_calloc(pf->arena, pf->zgrp, sizeof(*pf->grp));
+
+	for (size_t i = 0; i < pf->nposs; i++) {
+		pos_t p = pf->poss + i;
+		const_pfack_4217_t ccy;
+		struct ccy_grp_s *g;
+		size_t j;
+
+		switch (p->ty) {
+		case POSTY_CASH:
+			ccy = p->cash->tccy;
+			break;
+		case POSTY_FUT:
+			ccy = p->fut->ccy;
+			pf->fc.nx[p->fut - pf->fut] = NOFUT;
+			break;
+		default:
+			continue;
+		}
+		if (ccy == NULL) {
+			continue;
+		}
+		for (j = ((uintptr_t)ccy / sizeof(*ccy)) & (pf->zgrp - 1U);
+		     pf->grp[j].ccy != NULL && pf->grp[j].ccy != ccy;
+		     j = (j + 1U) & (pf->zgrp - 1U));
+		if ((g = pf->grp + j)->ccy == NULL) {
+			g->ccy = ccy;
+			g->fut = NOFUT;
+			g->fut_tail = &g->fut;
+		}
+
+		switch (p->ty) {
+		case POSTY_CASH:
+			if (g->cash == NULL) {
+				g->cash = p->cash;
+			}
+			g->last = p->cash;
+			break;
+		case POSTY_FUT:
+			*g->fut_tail = p->fut - pf->fut;
+			g->fut_tail = pf->fc.nx + (p->fut - pf->fut);
+			break;
+		default:
+			break;
+		}
+	}
+
+	/* now that all cash positions are known, link them up */
+	for (size_t i = 0; i < nf; i++) {
+		struct ccy_grp_s *g;
+
+		if ((g = find_ccy_grp(pf, pf->fut[i].ccy)) != NULL) {
+			pf->fc.cp[i] = g->cash;
+		}
+	}
+	cols_put(pf);
+	return;
+}
+
+static inline const struct urs_fut_kern_s*
+pf_fk(pf_t pf)
+{
+/* the futures kernels of PF, durst_model_t goes by urs_fut_model_t */
+	int m = pf->model >= 0 ? pf->model : (int)pf->ctx->model;
+
+	return urs_fut_kern + m;
+}
+
+/* future rebalancing relative to the NAV of the portfolio */
+static void
+reba_relanav_fut(pf_t pf, const struct urs_fut_kern_s *fk,
+		 size_t i, double tnav)
+{
+	/* band breach has been established by reba_relanav_check() */
+	fk->relanav(pf->fut + i, tnav, 0.0);
+	fut_col_put(pf, i);
+	pf->fc.rsz[i / 64U] |= 1ULL << (i % 64U);
+	return;
+}
+
+static void
+reba_relanav_cash(pf_t pf, size_t i, double tnav, double *bk)
+{
+/* the counter booking goes into BK, or the base position if NULL */
+	urs_cash_pos_t cp = pf->cash + i;
+	double ratio = (cp->term.soft + cp->term.hard) / tnav;
+	double lo, hi;
+
+	if ((lo = cp->band.lo) < 0.0 ||
+	    (hi = cp->band.hi) < 0.0 ||
+	    ratio < lo || ratio > hi) {
+		urs_cash_relanav_bk(cp, tnav, bk);
+		cash_col_put(pf, i);
+		pf->cc.tch[i / 64U] |= 1ULL << (i % 64U);
+		if (bk == NULL && cp->bp != NULL) {
+			/* the counter booking */
+			size_t j = cp->bp - pf->cash;
+
+			cash_col_put(pf, j);
+			pf->cc.tch[j / 64U] |= 1ULL << (j % 64U);
+		}
+	}
+	return;
+}
+
+static bool
+reba_relanav_check(pf_t pf, double nav)
+{
+/* mark all positions outside their bands in the breach masks,
+ * the nav we compare to is relative to the ccy of the pos,
+ * i.e. tnav = nav * stl, for cash positions this is needed for the
+ * rolandique definition of exposures */
+	const struct fut_col_s *fc = &pf->fc;
+	const struct cash_col_s *cc = &pf->cc;
+	size_t nbrk = 0U;
+
+	nbrk += kern_breach(fc->brk, fc->pos, fc->stl, nav,
+			    fc->lo, fc->hi, pf->nfut);
+	nbrk += kern_breach(cc->brk, cc->pos, cc->stl, nav,
+			    cc->lo, cc->hi, pf->ncash);
+
+#if defined DEBUG_FLAG
+	for (size_t i = 0; i < pf->nfut; i++) {
+		if (fc->brk[i / 64U] >> (i % 64U) & 1U) {
+			URS_DEBUG("\
+NEED REBA %.*s (%.4f): %.8g < %.8g NOT\n",
+				  (int)pf->fut[i].hdr.symz, pf->fut[i].hdr.sym,
+				  fc->pos[i], fc->lo[i], fc->hi[i]);
+		}
+	}
+	for (size_t i = 0; i < pf->ncash; i++) {
+		if (cc->brk[i / 64U] >> (i % 64U) & 1U) {
+			URS_DEBUG("\
+NEED REBA %.*s (%.4f/%.4f): %.8g < %.8g NOT\n",
+				  (int)pf->cash[i].hdr.symz, pf->cash[i].hdr.sym,
+				  cc->soft[i], cc->hard[i],
+				  cc->lo[i], cc->hi[i]);
+		}
+	}
+#endif	/* DEBUG_FLAG */
+	return nbrk == 0U;
+}
+
+struct reba_s {
+	pf_t pf;
+	const struct urs_fut_kern_s *fk;
+	double nav;
+	/* breaches over all blocks */
+	size_t nbrk;
+};
+
+static void
+__reba_fut_blk(void *clo, size_t k)
+{
+/* check block K of futures against their bands and rebalance the ones
+ * in breach, futures book into their own position only */
+	struct reba_s *rb = clo;
+	pf_t pf = rb->pf;
+	const struct fut_col_s *fc = &pf->fc;
+	const size_t lo = k * SPLIT_BLK;
+	const size_t hi = lo + SPLIT_BLK < pf->nfut ? lo + SPLIT_BLK : pf->nfut;
+	const double nav = rb->nav;
+	size_t nbrk;
+
+	nbrk = kern_breach(fc->brk + lo / 64U, fc->pos + lo, fc->stl + lo,
+			   nav, fc->lo + lo, fc->hi + lo, hi - lo);
+
+	for (size_t w = lo / 64U; w < (hi + 63U) / 64U; w++) {
+		for (uint64_t m = fc->brk[w]; m; m &= m - 1U) {
+			size_t i = 64U * w + __builtin_ctzll(m);
+			/* the nav we give here is relative to the ccy
+			 * of the pos */
+			urs_cash_pos_t cp = fc->cp[i];
+			double tnav = cp ? nav * cp->s_mkt->stl : 0.0;
+
+			reba_relanav_fut(pf, rb->fk, i, tnav);
+			URS_DEBUG("reba'd %.*s to %.4f (%.4f) (tnav %.4f)\n",
+				  (int)pf->fut[i].hdr.symz, pf->fut[i].hdr.sym,
+				  pf->fut[i].pos.hard, pf->fut[i].pos.soft,
+				  tnav);
+		}
+	}
+	__atomic_add_fetch(&rb->nbrk, nbrk, __ATOMIC_RELAXED);
+	return;
+}
+
+static void
+__reba_cash_rng(struct reba_s *rb, size_t lo, size_t hi, double *bk,
+		double *bkp)
+{
+/* rebalance the cash positions from LO to HI that are in breach, or
+ * have no band, LO is a multiple of 64, counter bookings go into BK,
+ * or else BKP by position, or else the base position */
+	pf_t pf = rb->pf;
+	const struct cash_col_s *cc = &pf->cc;
+
+	for (size_t w = lo / 64U; w < (hi + 63U) / 64U; w++) {
+		for (uint64_t m = cc->brk[w] | cc->free[w]; m; m &= m - 1U) {
+			size_t i = 64U * w + __builtin_ctzll(m);
+			double tnav = rb->nav * pf->cash[i].s_mkt->stl;
+			double *to = bk != NULL ? bk
+				: bkp != NULL ? bkp + i : NULL;
+
+			reba_relanav_cash(pf, i, tnav, to);
+			URS_DEBUG("reba'd %.*s to %.4f (%.4f) (tnav %.4f)\n",
+				  (int)pf->cash[i].hdr.symz,
+				  pf->cash[i].hdr.sym, pf->cash[i].term.hard,
+				  pf->cash[i].term.soft, tnav);
+		}
+	}
+	return;
+}
+
+static void
+__reba_cash_blk(void *clo, size_t k)
+{
+/* block K of the cash positions, bookings are kept by position to go
+ * in in order later, with DURST_SUM_PAIRWISE by block */
+	struct reba_s *rb = clo;
+	pf_t pf = rb->pf;
+	const size_t lo = k * SPLIT_BLK;
+	const size_t hi = lo + SPLIT_BLK < pf->ncash ? lo + SPLIT_BLK : pf->ncash;
+
+	if (pf->ctx->sum == DURST_SUM_PAIRWISE) {
+		pf->cc.bk[k] = 0.0;
+		__reba_cash_rng(rb, lo, hi, pf->cc.bk + k, NULL);
+	} else {
+		memset(pf->cc.bkp + lo, 0, (hi - lo) * sizeof(*pf->cc.bkp));
+		__reba_cash_rng(rb, lo, hi, NULL, pf->cc.bkp);
+	}
+	return;
+}
+
+static void
+reba_relanav(pf_t pf, double nav)
+{
+	struct reba_s rb = {.pf = pf, .fk = pf_fk(pf), .nav = nav};
+	const size_t nbf = (pf->nfut + SPLIT_BLK - 1U) / SPLIT_BLK;
+	const size_t nbc = (pf->ncash + SPLIT_BLK - 1U) / SPLIT_BLK;
+	const bool pwp = pf->ctx->sum == DURST_SUM_PAIRWISE;
+	const team_t t = pf_team(pf);
+	urs_cash_pos_t bp = NULL;
+
+	/* futures in breach are independent of one another, and of the
+	 * cash positions, so they're done right away */
+	team_run(t, __reba_fut_blk, &rb, nbf);
+	rb.nbrk += kern_breach(pf->cc.brk, pf->cc.pos, pf->cc.stl, nav,
+			       pf->cc.lo, pf->cc.hi, pf->ncash);
+	if (rb.nbrk == 0U) {
+		URS_DEBUG("NO REBA NEEDED\n");
+		return;
+	}
+
+	URS_DEBUG("NEED REBA\n");
+	/* cash positions book into the base position (they all share
+	 * one), in input order; when they're split over a team blocks
+	 * hold on to their bookings which go in in order afterwards,
+	 * summed pairwise blocks accumulate theirs, unless the base
+	 * position is rebalanced itself and would see them */
+	for (size_t i = 0; ((t != NULL && nbc > 1U) || pwp) &&
+		     i < pf->ncash && !bp; i++) {
+		bp = pf->cash[i].bp;
+	}
+	if (bp == NULL || bp->band.med >= 0.0) {
+		__reba_cash_rng(&rb, 0U, pf->ncash, NULL, NULL);
+		return;
+	}
+	team_run(t, __reba_cash_blk, &rb, nbc);
+	if (pwp) {
+		bp->forex += __pw_sum(pf->cc.bk, nbc);
+	}
+	/* in input order, x + -y is x - y, so that's what going
+	 * through them one by one gives */
+	for (size_t i = 0U; !pwp && i < pf->ncash; i++) {
+		if (pf->cc.bkp[i] != 0.0) {
+			bp->forex += pf->cc.bkp[i];
+		}
+	}
+	cash_col_put(pf, bp - pf->cash);
+	pf->cc.tch[(bp - pf->cash) / 64U] |= 1ULL << ((bp - pf->cash) % 64U);
+	return;
+}
+
+
+static struct map_s*
+map_ref(struct map_s *m)
+{
+	__atomic_add_fetch(&m->nref, 1U, __ATOMIC_RELAXED);
+	return m;
+}
+
+static void
+map_unref(struct map_s *m)
+{
+	if (__atomic_sub_fetch(&m->nref, 1U, __ATOMIC_ACQ_REL) == 0U) {
+		munmap((void*)m->p, m->z);
+		free(m);
+	}
+	return;
+}
+
+static void
+inc_trim(durst_ctx_t ctx)
+{
+	if (ctx->nlag == 0U) {
+		ctx->qbase += ctx->nqlog;
+		ctx->nqlog = 0U;
+	}
+	return;
+}
+
+static void
+inc_drop(pf_t pf)
+{
+/* stop valuing PF incrementally, only serve mode does that and
+ * it's single-threaded */
+	durst_ctx_t ctx = pf->ctx;
+
+	if (!pf->incp) {
+		return;
+	}
+	ctx->ninc--;
+	if (pf->qlog < ctx->qbase + ctx->nqlog) {
+		ctx->nlag--;
+		inc_trim(ctx);
+	}
+	pf->incp = false;
+	return;
+}
+
+static void
+free_pf(pf_t pf)
+{
+/* all of PF lives in its arena, hand that back to the context */
+	durst_ctx_t ctx = pf->ctx;
+	arena_t a = pf->arena;
+
+	inc_drop(pf);
+	if (pf->map != NULL) {
+		map_unref(pf->map);
+	}
+	for (size_t i = 0; i < pf->nmref; i++) {
+		__drop_mkt(pf->mref[i]);
+	}
+	arena_reset(a);
+	pthread_mutex_lock(&ctx->amtx);
+	if (ctx->narena >= ctx->zarena) {
+		ctx->zarena = ctx->zarena ? 2U * ctx->zarena : 16U;
+		ctx->arena = realloc(
+			ctx->arena, ctx->zarena * sizeof(*ctx->arena));
+	}
+	ctx->arena[ctx->narena++] = a;
+	pthread_mutex_unlock(&ctx->amtx);
+	return;
+}
+
+static pf_t
+make_pf(durst_ctx_t ctx)
+{
+	arena_t a = NULL;
+	pf_t res;
+
+	pthread_mutex_lock(&ctx->amtx);
+	if (ctx->narena > 0U) {
+		a = ctx->arena[--ctx->narena];
+	}
+	pthread_mutex_unlock(&ctx->amtx);
+	if (a == NULL) {
+		a = make_arena();
+	}
+	res = arena_calloc(a, 1U, sizeof(*res));
+	res->arena = a;
+	res->ctx = ctx;
+	res->model = -1;
+	return res;
+}
+
+static void
+fprint_pfid(pf_t pf, struct obuf_s *ob)
+{
+/* tag output lines with the portfolio id in batch mode */
+	if (pf->id != NULL) {
+		ob_adds(ob, pf->id);
+		ob_addc(ob, '\t');
+	}
+	return;
+}
+
+static void
+fprint_4f(struct obuf_s *ob, const char *pre, double x)
+{
+	ob_adds(ob, pre);
+	ob_add_4f(ob, x);
+	return;
+}
+
+static void
+fprint_pos(pf_t pf, pos_t pos, double nav, struct obuf_s *ob)
+{
+	switch (pos->ty) {
+	case POSTY_UNK:
+	default:
+		break;
+
+	case POSTY_CASH: {
+		double tcv = urs_cash_value(pos->cash);
+		double nav = pf->val.soft + pf->val.hard;
+
+		/* CASH sym\tsoft %.4f\thard %.4f\tfx %.4f\t%.6e v %.6e */
+		ob_add(ob, "CASH ", 5U);
+		ob_add(ob, pos->cash->hdr.sym, pos->cash->hdr.symz);
+		fprint_4f(ob, "\tsoft ", pos->cash->term.soft);
+		fprint_4f(ob, "\thard ", pos->cash->term.hard);
+		fprint_4f(ob, "\tfx ", pos->cash->forex);
+		ob_addc(ob, '\t');
+		ob_add_6e(ob, tcv / nav);
+		ob_add(ob, " v ", 3U);
+		ob_add_6e(ob, pos->cash->band.med);
+		ob_addc(ob, '\n');
+		break;
+	}
+
+	case POSTY_FUT: {
+		urs_cash_pos_t cp = find_cash_pos(pf, pos);
+		double tnav = cp ? nav * cp->s_mkt->stl : 0.0;
+		double ex = cp
+			? (pos->fut->pos.hard + pos->fut->pos.soft) / tnav : 0.0;
+
+		/* FUT sym\t%.4f (%.4f)\t* %.4f\t@ %.4f/%.4f\t
+		 * soft %.4f\thard %.4f\t%.6e v %.6e */
+		ob_add(ob, "FUT ", 4U);
+		ob_add(ob, pos->fut->hdr.sym, pos->fut->hdr.symz);
+		fprint_4f(ob, "\t", pos->fut->pos.hard);
+		fprint_4f(ob, " (", pos->fut->pos.soft);
+		fprint_4f(ob, ")\t* ", pos->fut->mult);
+		fprint_4f(ob, "\t@ ", pos->fut->f_mkt->bid);
+		fprint_4f(ob, "/", pos->fut->f_mkt->ask);
+		fprint_4f(ob, "\tsoft ", pos->fut->term.soft);
+		fprint_4f(ob, "\thard ", pos->fut->term.hard);
+		ob_addc(ob, '\t');
+		ob_add_6e(ob, ex);
+		ob_add(ob, " v ", 3U);
+		ob_add_6e(ob, pos->fut->band.med);
+		ob_addc(ob, '\n');
+		break;
+	}
+	}
+	return;
+}
+
+static void
+fprint_poss(pf_t pf, struct obuf_s *ob)
+{
+	double nav = compute_pf_val(pf);
+
+	ob_add(ob, "PORTFOLIO\t", 10U);
+	fprint_pfid(pf, ob);
+	fprint_4f(ob, "soft ", pf->val.soft);
+	fprint_4f(ob, "\thard ", pf->val.hard);
+	fprint_4f(ob, "\tnav ", nav);
+	ob_addc(ob, '\n');
+	for (size_t i = 0; i < pf->ncash; i++) {
+		ob_add(ob, "TERM\t", 5U);
+		ob_adds(ob, pf->cash[i].tccy->sym);
+		fprint_4f(ob, "\tsoft ", pf->val.soft * pf->cash[i].s_mkt->stl);
+		fprint_4f(ob, "\thard ", pf->val.hard * pf->cash[i].s_mkt->stl);
+		fprint_4f(ob, "\tnav ", nav * pf->cash[i].s_mkt->stl);
+		ob_addc(ob, '\n');
+	}
+	for (size_t i = 0; i < pf->nposs; i++) {
+		fprint_pos(pf, pf->poss + i, nav, ob);
+	}
+	return;
+}
+
+static struct __hdr_s
+__ccy_hdr(const_pfack_4217_t ccy)
+{
+	if (ccy == NULL) {
+		/* positions in currencies we don't know, printf used
+		 * to make this of it */
+		return (struct __hdr_s){"(null)", 6U, URS_NOSYM};
+	}
+	return (struct __hdr_s){ccy->sym, strlen(ccy->sym), URS_NOSYM};
+}
+
+static void
+fprint_trade(pf_t pf, const char *act, double amt, struct __hdr_s h,
+	     struct obuf_s *ob)
+{
+	/* [id\t]act\t%.4f\tsym */
+	fprint_pfid(pf, ob);
+	ob_adds(ob, act);
+	ob_addc(ob, '\t');
+	ob_add_4f(ob, amt);
+	ob_addc(ob, '\t');
+	ob_add(ob, h.sym, h.symz);
+	ob_addc(ob, '\n');
+	return;
+}
+
+static void
+fprint_trades(pf_t pf, struct obuf_s *ob)
+{
+	/* traverse the soft pos's to emit trades */
+	for (size_t i = 0; i < pf->nposs; i++) {
+		pos_t p = pf->poss + i;
+
+		switch (p->ty) {
+		case POSTY_CASH: {
+			double d = p->cash->term.hard - p->cash->hard_ini;
+			double dfx = p->cash->forex;
+
+			if (d > 0.0) {
+				fprint_trade(pf, "CLEAR", d,
+					p->cash->hdr, ob);
+			} else if (d < 0.0) {
+				fprint_trade(pf, "CLEAR", d,
+					p->cash->hdr, ob);
+			}
+
+			/* do not buy or sell base currency?
+			 * at the moment we use the criterion, if it's not
+			 * balanced do fuckall */
+			if (p->cash->band.med < 0.0) {
+				break;
+			}
+
+			if (dfx > 0.0) {
+				fprint_trade(pf, "BUY", dfx,
+					__ccy_hdr(p->cash->tccy), ob);
+			} else if (dfx < 0.0) {
+				fprint_trade(pf, "SELL", -dfx,
+					__ccy_hdr(p->cash->tccy), ob);
+			}
+			break;
+		}
+		case POSTY_FUT:
+			if (p->fut->pos.soft > 0.0 &&
+			    p->fut->pos.hard < 0.0) {
+				fprint_trade(pf, "SHORT_BUY", p->fut->pos.soft,
+					p->fut->hdr, ob);
+			} else if (p->fut->pos.soft > 0.0) {
+				fprint_trade(pf, "BUY", p->fut->pos.soft,
+					p->fut->hdr, ob);
+			} else if (p->fut->pos.soft < 0.0 &&
+				   p->fut->pos.hard > 0.0) {
+				fprint_trade(pf, "SELL", -p->fut->pos.soft,
+					p->fut->hdr, ob);
+			} else if (p->fut->pos.soft < 0.0) {
+				fprint_trade(pf, "SHORT_SELL", -p->fut->pos.soft,
+					p->fut->hdr, ob);
+			}
+
+			if (p->fut->term.hard != 0.0) {
+				fprint_trade(pf, "CLEAR", p->fut->term.hard,
+					__ccy_hdr(p->fut->ccy), ob);
+			}
+			if (p->fut->term.soft != 0.0) {
+				fprint_trade(pf, "CLEAR", p->fut->term.soft,
+					__ccy_hdr(p->fut->ccy), ob);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	return;
+}
+
+/* FIXML 5.0 SP2 NewOrderSingle messages, one per line, the constant
+ * bits are laid out here once and only symbols, currencies and
+ * quantities are patched in */
+struct fixml_tpl_s {
+	const char *s;
+	size_t z;
+};
+#define TPL(x)	{x, sizeof(x) - 1U}
+
+static const struct fixml_tpl_s fixml_beg = TPL("<FIXML v=\"5.0 SP2\"><Order ID=\"");
+static const struct fixml_tpl_s fixml_acct = TPL("\" Acct=\"");
+static const struct fixml_tpl_s fixml_ccy = TPL(" Typ=\"1\" Ccy=\"");
+static const struct fixml_tpl_s fixml_settl = TPL("\" SettlCcy=\"");
+static const struct fixml_tpl_s fixml_sym = TPL("\"><Instrmt Sym=\"");
+static const struct fixml_tpl_s fixml_fut = TPL("\" SecTyp=\"FUT\"/><OrdQty Qty=\"");
+static const struct fixml_tpl_s fixml_fx = TPL("\" SecTyp=\"FXSPOT\"/><OrdQty Qty=\"");
+static const struct fixml_tpl_s fixml_end = TPL("\"/></Order></FIXML>\n");
+
+/* side and position effect, indexed by fixml_side_t */
+typedef enum {
+	FIXML_BUY,
+	FIXML_SELL,
+	FIXML_SHORT_BUY,
+	FIXML_SHORT_SELL,
+	FIXML_FX_BUY,
+	FIXML_FX_SELL,
+} fixml_side_t;
+
+static const struct fixml_tpl_s fixml_side[] = {
+	[FIXML_BUY] = TPL("\" Side=\"1\" PosEfct=\"O\""),
+	[FIXML_SELL] = TPL("\" Side=\"2\" PosEfct=\"C\""),
+	[FIXML_SHORT_BUY] = TPL("\" Side=\"1\" PosEfct=\"C\""),
+	[FIXML_SHORT_SELL] = TPL("\" Side=\"5\" PosEfct=\"O\""),
+	[FIXML_FX_BUY] = TPL("\" Side=\"1\""),
+	[FIXML_FX_SELL] = TPL("\" Side=\"2\""),
+};
+#undef TPL
+
+static void
+fprint_tpl(struct obuf_s *ob, struct fixml_tpl_s t)
+{
+	ob_add(ob, t.s, t.z);
+	return;
+}
+
+static void
+fprint_xml(struct obuf_s *ob, const char *s, size_t z)
+{
+/* attribute values, ids and symbols rarely need escaping */
+	size_t i;
+
+	for (i = 0U; i < z; i++) {
+		switch (s[i]) {
+		case '&':
+		case '<':
+		case '>':
+		case '"':
+			goto esc;
+		default:
+			continue;
+		}
+	}
+	ob_add(ob, s, z);
+	return;
+esc:
+	ob_add(ob, s, i);
+	for (; i < z; i++) {
+		switch (s[i]) {
+		case '&':
+			ob_add(ob, "&amp;", 5U);
+			break;
+		case '<':
+			ob_add(ob, "&lt;", 4U);
+			break;
+		case '>':
+			ob_add(ob, "&gt;", 4U);
+			break;
+		case '"':
+			ob_add(ob, "&quot;", 6U);
+			break;
+		default:
+			ob_addc(ob, s[i]);
+			break;
+		}
+	}
+	return;
+}
+
+static void
+fprint_order_fixml(
+	pf_t pf, size_t seq, fixml_side_t side, double qty,
+	struct __hdr_s sym, const_pfack_4217_t ccy, struct obuf_s *ob)
+{
+	struct __hdr_s c = __ccy_hdr(ccy);
+	char id[24U];
+	int idz;
+
+	/* order ids are unique within a portfolio, ID and Acct together
+	 * are unique within a batch */
+	idz = snprintf(id, sizeof(id), "%zu", seq);
+
+	fprint_tpl(ob, fixml_beg);
+	ob_add(ob, id, idz);
+	if (pf->id != NULL) {
+		fprint_tpl(ob, fixml_acct);
+		fprint_xml(ob, pf->id, strlen(pf->id));
+	}
+	fprint_tpl(ob, fixml_side[side]);
+	fprint_tpl(ob, fixml_ccy);
+	fprint_xml(ob, c.sym, c.symz);
+	if (side >= FIXML_FX_BUY) {
+		fprint_tpl(ob, fixml_settl);
+		ob_adds(ob, pf->bccy->sym);
+	}
+	fprint_tpl(ob, fixml_sym);
+	fprint_xml(ob, sym.sym, sym.symz);
+	fprint_tpl(ob, side >= FIXML_FX_BUY ? fixml_fx : fixml_fut);
+	ob_add_4f(ob, qty);
+	fprint_tpl(ob, fixml_end);
+	return;
+}
+
+static void
+fprint_trades_fixml(pf_t pf, struct obuf_s *ob)
+{
+	size_t seq = 0U;
+
+	/* traverse the soft pos's to emit orders, cash clearing isn't
+	 * an order so it goes unmentioned */
+	for (size_t i = 0; i < pf->nposs; i++) {
+		pos_t p = pf->poss + i;
+
+		switch (p->ty) {
+		case POSTY_CASH: {
+			urs_cash_pos_t cp = p->cash;
+
+			/* unbalanced (base) currencies aren't traded,
+			 * like in the csv output */
+			if (cp->band.med < 0.0) {
+				break;
+			} else if (cp->forex > 0.0) {
+				fprint_order_fixml(
+					pf, ++seq, FIXML_FX_BUY, cp->forex,
+					__ccy_hdr(cp->tccy), cp->tccy, ob);
+			} else if (cp->forex < 0.0) {
+				fprint_order_fixml(
+					pf, ++seq, FIXML_FX_SELL, -cp->forex,
+					__ccy_hdr(cp->tccy), cp->tccy, ob);
+			}
+			break;
+		}
+		case POSTY_FUT: {
+			urs_fut_pos_t fp = p->fut;
+			fixml_side_t side;
+			double qty;
+
+			if (fp->pos.soft > 0.0 && fp->pos.hard < 0.0) {
+				side = FIXML_SHORT_BUY;
+			} else if (fp->pos.soft > 0.0) {
+				side = FIXML_BUY;
+			} else if (fp->pos.soft < 0.0 && fp->pos.hard > 0.0) {
+				side = FIXML_SELL;
+			} else if (fp->pos.soft < 0.0) {
+				side = FIXML_SHORT_SELL;
+			} else {
+				break;
+			}
+			qty = fabs(fp->pos.soft);
+			fprint_order_fixml(
+				pf, ++seq, side, qty, fp->hdr, fp->ccy, ob);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	return;
+}
+
+/* binary trades, see durst.h for the layout */
+#define BIN_RECZ	(32U)
+#define BIN_NAMZ	(24U)
+
+struct bin_s {
+	/* symbol ids named already */
+	uint64_t *named;
+	uint32_t seq;
+};
+
+static inline void
+__put_le16(unsigned char *p, uint_fast16_t x)
+{
+	p[0U] = (unsigned char)x;
+	p[1U] = (unsigned char)(x >> 8U);
+	return;
+}
+
+static inline void
+__put_le32(unsigned char *p, uint_fast32_t x)
+{
+	__put_le16(p, x);
+	__put_le16(p + 2U, x >> 16U);
+	return;
+}
+
+static inline void
+__put_le64(unsigned char *p, uint_fast64_t x)
+{
+	__put_le32(p, x);
+	__put_le32(p + 4U, x >> 32U);
+	return;
+}
+
+static void
+fprint_name_bin(
+	struct obuf_s *ob, durst_bin_typ_t typ, uint32_t id,
+	const char *s, size_t z)
+{
+	unsigned char rec[BIN_RECZ] = {typ, z < 255U ? z : 255U};
+
+	if (z > 255U) {
+		z = 255U;
+	}
+	__put_le32(rec + 4U, id);
+	memcpy(rec + 8U, s, z < BIN_NAMZ ? z : BIN_NAMZ);
+	ob_add(ob, (const char*)rec, sizeof(rec));
+	for (size_t i = BIN_NAMZ; i < z; i += BIN_NAMZ) {
+		size_t n = z - i < BIN_NAMZ ? z - i : BIN_NAMZ;
+
+		memset(rec, 0, sizeof(rec));
+		rec[0U] = DURST_BIN_CONT;
+		memcpy(rec + 8U, s + i, n);
+		ob_add(ob, (const char*)rec, sizeof(rec));
+	}
+	return;
+}
+
+static void
+fprint_trade_bin(
+	pf_t pf, struct bin_s *st, durst_bin_side_t side, double amt,
+	struct __hdr_s h, const_pfack_4217_t ccy, struct obuf_s *ob)
+{
+	unsigned char rec[BIN_RECZ] = {DURST_BIN_TRADE, side};
+	uint64_t amtb;
+
+	if (h.id != URS_NOSYM &&
+	    !(st->named[h.id / 64U] & (1ULL << (h.id % 64U)))) {
+		fprint_name_bin(ob, DURST_BIN_SYM, h.id, h.sym, h.symz);
+		st->named[h.id / 64U] |= 1ULL << (h.id % 64U);
+	}
+	memcpy(&amtb, &amt, sizeof(amtb));
+	if (ccy != NULL) {
+		/* unknown currencies stay naught */
+		__put_le16(rec + 2U, ccy->cod);
+		memcpy(rec + 4U, ccy->sym, strnlen(ccy->sym, 4U));
+	}
+	__put_le32(rec + 8U, pf->seq);
+	__put_le32(rec + 12U, h.id);
+	__put_le64(rec + 16U, amtb);
+	__put_le32(rec + 24U, ++st->seq);
+	ob_add(ob, (const char*)rec, sizeof(rec));
+	return;
+}
+
+static void
+fprint_trades_bin(pf_t pf, struct obuf_s *ob)
+{
+	/* scratch, portfolios can be printed any number of times */
+	uint64_t named[16U] = {0U};
+	const size_t nw = pf->nsym / 64U + 1U;
+	struct bin_s st = {
+		.named = nw > countof(named)
+		? calloc(nw, sizeof(*named)) : named,
+	};
+
+	fprint_name_bin(ob, DURST_BIN_PF, pf->seq,
+			pf->id, pf->id ? strlen(pf->id) : 0U);
+	/* same trades as fprint_trades() */
+	for (size_t i = 0; i < pf->nposs; i++) {
+		pos_t p = pf->poss + i;
+
+		switch (p->ty) {
+		case POSTY_CASH: {
+			urs_cash_pos_t cp = p->cash;
+			double d = cp->term.hard - cp->hard_ini;
+			double dfx = cp->forex;
+
+			if (d > 0.0 || d < 0.0) {
+				fprint_trade_bin(pf, &st, DURST_BIN_CLEAR, d,
+						 cp->hdr, cp->tccy, ob);
+			}
+			if (cp->band.med < 0.0) {
+				break;
+			}
+			if (dfx > 0.0) {
+				fprint_trade_bin(pf, &st, DURST_BIN_BUY, dfx,
+						 __ccy_hdr(cp->tccy),
+						 cp->tccy, ob);
+			} else if (dfx < 0.0) {
+				fprint_trade_bin(pf, &st, DURST_BIN_SELL, -dfx,
+						 __ccy_hdr(cp->tccy),
+						 cp->tccy, ob);
+			}
+			break;
+		}
+		case POSTY_FUT: {
+			urs_fut_pos_t fp = p->fut;
+			durst_bin_side_t side;
+
+			if (fp->pos.soft > 0.0 && fp->pos.hard < 0.0) {
+				side = DURST_BIN_SHORT_BUY;
+			} else if (fp->pos.soft > 0.0) {
+				side = DURST_BIN_BUY;
+			} else if (fp->pos.soft < 0.0 && fp->pos.hard > 0.0) {
+				side = DURST_BIN_SELL;
+			} else if (fp->pos.soft < 0.0) {
+				side = DURST_BIN_SHORT_SELL;
+			} else {
+				side = 0;
+			}
+			if (side) {
+				fprint_trade_bin(pf, &st, side,
+						 fabs(fp->pos.soft),
+						 fp->hdr, fp->ccy, ob);
+			}
+			if (fp->term.hard != 0.0) {
+				fprint_trade_bin(pf, &st, DURST_BIN_CLEAR,
+						 fp->term.hard,
+						 __ccy_hdr(fp->ccy), fp->ccy, ob);
+			}
+			if (fp->term.soft != 0.0) {
+				fprint_trade_bin(pf, &st, DURST_BIN_CLEAR,
+						 fp->term.soft,
+						 __ccy_hdr(fp->ccy), fp->ccy, ob);
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	if (st.named != named) {
+		free(st.named);
+	}
+	return;
+}
+
+static void __attribute__((unused))
+fprint_info(pf_t pf, struct obuf_s *ob)
+{
+	/* traverse the soft pos's to emit trades */
+	for (size_t i = 0; i < pf->nposs; i++) {
+		pos_t p = pf->poss + i;
+
+		switch (p->ty) {
+		case POSTY_CASH: {
+			double d = p->cash->term.soft - p->cash->soft_ini;
+			fprint_trade(pf, "INFO", d, p->cash->hdr, ob);
+		}
+		default:
+			break;
+		}
+	}
+	return;
+}
+
+static double
+reco_poss_ccy_s(pf_t pf, const_pfack_4217_t ccy)
+{
+/* go through all future positions and sum up their counter positions,
+ * then find a cash position to book this to. */
+	double sum = 0.0;
+
+	for (size_t i = 0; i < pf->nfut; i++) {
+		if (pf->fut[i].ccy->cod == ccy->cod) {
+			/* futures account for nothing */
+		}
+	}
+	return sum;
+}
+
+static double
+reco_poss_ccy_h(pf_t pf, const_pfack_4217_t ccy)
+{
+/* go through all future positions and sum up their counter positions,
+ * then find a cash position to book this to. */
+	struct ccy_grp_s *g = find_ccy_grp(pf, ccy);
+	double sum = 0.0;
+
+	for (size_t i = g ? g->fut : NOFUT; i != NOFUT; i = pf->fc.nx[i]) {
+		sum += pf->fut[i].term.hard;
+	}
+	return sum;
+}
+
+static void
+reco_poss_freeze(pf_t pf)
+{
+/* go through all cash positions and gather any softs left over from
+ * rebalancing, book it into the soft account of the cash position. */
+	for (size_t i = 0; i < pf->ncash; i++) {
+		urs_cash_pos_t cp = pf->cash + i;
+		if (cp->tccy != NULL) {
+			cp->soft_ini = cp->term.soft;
+			cp->hard_ini = cp->term.hard;
+			cp->forex_ini = cp->forex;
+		}
+	}
+	return;
+}
+
+static void
+reco_poss_thaw(pf_t pf)
+{
+/* go through all cash positions and gather any softs left over from
+ * rebalancing, book it into the soft account of the cash position. */
+	for (size_t i = 0; i < pf->ncash; i++) {
+		urs_cash_pos_t cp = pf->cash + i;
+		if (cp->tccy != NULL) {
+			cp->term.soft = cp->soft_ini;
+			cp->term.hard = cp->hard_ini;
+			cp->forex = cp->forex_ini;
+			cash_col_put(pf, i);
+		}
+	}
+	return;
+}
+
+static void
+reco_poss_reset(pf_t pf)
+{
+	for (size_t i = 0; i < pf->ncash; i++) {
+		urs_cash_pos_t cp = pf->cash + i;
+		if (cp->tccy != NULL) {
+			cp->term.soft = cp->soft_ini;
+			cp->term.hard = cp->hard_ini;
+			cp->forex = 0.0;
+			cash_col_put(pf, i);
+		}
+	}
+	return;
+}
+
+static void
+reco_poss_settle(pf_t pf)
+{
+/* like reco_poss_freeze() followed by reco_poss_reset() but for the
+ * positions on the worklist only, the others have had no forex booked
+ * in this pass nor the one before, so both would leave them be */
+	const size_t nw = (pf->ncash + 63U) / 64U;
+
+	for (size_t w = 0; w < nw; w++) {
+		for (uint64_t m = pf->cc.wl[w] | pf->cc.tch[w]; m; m &= m - 1U) {
+			size_t i = 64U * w + __builtin_ctzll(m);
+			urs_cash_pos_t cp = pf->cash + i;
+
+			if (cp->tccy != NULL) {
+				cp->soft_ini = cp->term.soft;
+				cp->hard_ini = cp->term.hard;
+				cp->forex_ini = cp->forex;
+				cp->forex = 0.0;
+				cash_col_put(pf, i);
+			}
+		}
+		pf->cc.wl[w] = pf->cc.tch[w];
+		pf->cc.tch[w] = 0U;
+	}
+	return;
+}
+
+static void __attribute__((unused))
+reco_poss(pf_t pf)
+{
+/* go through all cash positions and gather any softs left over from
+ * rebalancing, book it into the soft account of the cash position. */
+	for (size_t i = 0; i < pf->ncash; i++) {
+		urs_cash_pos_t cp = pf->cash + i;
+		if (cp->tccy != NULL) {
+			cp->term.soft += reco_poss_ccy_s(pf, cp->tccy);
+			cp->term.hard += reco_poss_ccy_h(pf, cp->tccy);
+			cash_col_put(pf, i);
+		}
+	}
+	return;
+}
+
+static void
+set_base_ccy_fut(pf_t pf, const_pfack_4217_t ccy, double val_fac)
+{
+	struct ccy_grp_s *g = find_ccy_grp(pf, ccy);
+
+	for (size_t i = g ? g->fut : NOFUT; i != NOFUT; i = pf->fc.nx[i]) {
+		pf->fut[i].val_fac = val_fac;
+	}
+	return;	
+}
+
+static void
+set_base_currency(pf_t pf, const_pfack_4217_t ccy)
+{
+	struct ccy_grp_s *g;
+	urs_cash_pos_t bp;
+
+	/* start out by setting all CCY future position factors to 1.0 */
+	set_base_ccy_fut(pf, ccy, 1.0);
+	inc_drop(pf);
+
+	/* find the base currency cash position */
+	bp = (g = find_ccy_grp(pf, ccy)) != NULL ? g->cash : NULL;
+
+	/* find the currency in question, otherwise create a position */
+	for (size_t i = 0; i < pf->ncash; i++) {
+		urs_cash_pos_t cp = pf->cash + i;
+		if (cp->tccy != ccy) {
+			g = find_ccy_grp(pf, cp->tccy);
+			if (g != NULL && g->last == cp) {
+				/* only the last one counts */
+				set_base_ccy_fut(pf, cp->tccy, cp->s_mkt->stl);
+			}
+			cp->bp = bp;
+		}
+	}
+
+	/* to avoid confusion, we nil out all the stuff that has no ccy
+	 * val fac */
+	for (size_t i = 0; i < pf->nfut; i++) {
+		urs_fut_pos_t fp = pf->fut + i;
+		if (fp->val_fac == 0.0) {
+			fp->band.lo =
+				fp->band.med =
+				fp->band.hi = 0.0;
+			fp->val_fac = -1.0;
+		}
+	}
+	pf->bccy = ccy;
+	cols_put(pf);
+	return;
+}
+
+static posty_t
+__parse_posty(const char *s)
+{
+	static const char c[] = "CASH";
+	static const char f[] = "FUT";
+	static const char fx[] = "FX";
+	static const char stk[] = "STK";
+	static const char nav[] = "NAV";
+	static const char mod[] = "MODEL";
+
+	if (strncmp(s, c, sizeof(c) - 1) == 0) {
+		return POSTY_CASH;
+	} else if (strncmp(s, f, sizeof(f) - 1) == 0) {
+		return POSTY_FUT;
+	} else if (strncmp(s, fx, sizeof(fx) - 1) == 0) {
+		return POSTY_FX;
+	} else if (strncmp(s, stk, sizeof(stk) - 1) == 0) {
+		return POSTY_STK;
+	} else if (strncmp(s, nav, sizeof(nav) - 1) == 0) {
+		return POSTY_NAV;
+	} else if (strncmp(s, mod, sizeof(mod) - 1) == 0) {
+		return POSTY_MODEL;
+	}
+	return POSTY_UNK;
+}
+
+static const char*
+__skip_behind_tab(const char *s, const char *eol)
+{
+	const char *t = memchr(s, '\t', eol - s);
+	return t != NULL ? t + 1 : eol;
+}
+
+static inline size_t
+__field_len(const char *s, const char *p)
+{
+/* the length of the field from S up to P, behind its tab */
+	return p > s && p[-1] == '\t' ? p - s - 1 : p - s;
+}
+
+static inline uint_fast32_t
+__4217_key(const char *sym, size_t z)
+{
+/* pack the first 3 of the Z characters of SYM into an integer */
+	uint_fast32_t k = 0U;
+
+	for (size_t i = 0; i < 3U && i < z && sym[i]; i++) {
+		k |= (uint_fast32_t)(unsigned char)sym[i] << (8U * i);
+	}
+	return k;
+}
+
+static inline size_t
+__4217_slot(uint_fast32_t k, size_t z)
+{
+	k ^= k >> 13U;
+	k *= 0x9e3779b1U;
+	k ^= k >> 16U;
+	return k & (z - 1U);
+}
+
+static const_pfack_4217_t
+__find_4217(durst_ctx_t ctx, const char *sym, size_t z)
+{
+/* the currency of the Z characters at SYM, which needn't be terminated,
+ * ISO ones never touch the custom table, see durst_pf_set_base() */
+	uint_fast32_t k;
+
+	if (z >= 3U &&
+	    sym[0U] >= 'A' && sym[0U] <= 'Z' &&
+	    sym[1U] >= 'A' && sym[1U] <= 'Z' &&
+	    sym[2U] >= 'A' && sym[2U] <= 'Z') {
+		size_t ik = (sym[0U] - 'A') * 676U +
+			(sym[1U] - 'A') * 26U + (sym[2U] - 'A');
+		uint_fast16_t i;
+
+		if ((i = pfack_4217_idx[ik])) {
+			return PFACK_4217(i - 1U);
+		}
+	}
+	if (ctx->nmy4217 == 0U) {
+		return NULL;
+	}
+	/* try the custom ones */
+	k = __4217_key(sym, z);
+	for (size_t i = __4217_slot(k, ctx->zmy4217);;
+	     i = (i + 1U) & (ctx->zmy4217 - 1U)) {
+		const_pfack_4217_t c;
+
+		if ((c = ctx->my4217[i]) == NULL) {
+			break;
+		} else if (__4217_key(c->sym, sizeof(c->sym)) == k) {
+			return c;
+		}
+	}
+	return NULL;
+}
+
+static void
+__rehash_4217(durst_ctx_t ctx, size_t nuz)
+{
+	const_pfack_4217_t *nu = calloc(nuz, sizeof(*nu));
+
+	for (size_t j = 0; j < ctx->zmy4217; j++) {
+		const_pfack_4217_t c;
+		size_t i;
+
+		if ((c = ctx->my4217[j]) == NULL) {
+			continue;
+		}
+		for (i = __4217_slot(__4217_key(c->sym, sizeof(c->sym)), nuz);
+		     nu[i] != NULL; i = (i + 1U) & (nuz - 1U));
+		nu[i] = c;
+	}
+	free(ctx->my4217);
+	ctx->my4217 = nu;
+	ctx->zmy4217 = nuz;
+	return;
+}
+
+static const_pfack_4217_t
+__add_4217(durst_ctx_t ctx, const char *sym, size_t z)
+{
+/* create a custom currency of the Z characters at SYM, we just assume
+ * it's not there yet */
+	struct my4217_blk_s *b = ctx->my4217_blk;
+	pfack_4217_t res;
+	size_t i;
+
+	if (b == NULL || b->n >= countof(b->c)) {
+		b = calloc(1, sizeof(*b));
+		b->next = ctx->my4217_blk;
+		ctx->my4217_blk = b;
+	}
+	res = b->c + b->n++;
+	for (i = 0; i < 3U && i < z && sym[i]; i++) {
+		((char*)res->sym)[i] = sym[i];
+	}
+
+	/* keep the load below one half */
+	if (2U * (ctx->nmy4217 + 1U) > ctx->zmy4217) {
+		__rehash_4217(ctx, ctx->zmy4217 ? 2U * ctx->zmy4217 : 16U);
+	}
+	for (i = __4217_slot(__4217_key(res->sym, sizeof(res->sym)), ctx->zmy4217);
+	     ctx->my4217[i] != NULL; i = (i + 1U) & (ctx->zmy4217 - 1U));
+	ctx->my4217[i] = res;
+	ctx->nmy4217++;
+	return res;
+}
+
+#if defined HAVE_STRTOD_L
+static locale_t c_locale;
+static pthread_once_t c_locale_once = PTHREAD_ONCE_INIT;
+
+static void
+init_c_locale(void)
+{
+	c_locale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+	return;
+}
+#endif	/* HAVE_STRTOD_L */
+
+static double
+__strtod_c(const char *s)
+{
+/* strtod() in the C locale, whatever the process' locale is,
+ * numbers end in a tab or newline at the latest */
+#if defined HAVE_STRTOD_L
+	pthread_once(&c_locale_once, init_c_locale);
+	if (c_locale != (locale_t)0) {
+		return strtod_l(s, NULL, c_locale);
+	}
+#endif	/* HAVE_STRTOD_L */
+	return strtod(s, NULL);
+}
+
+static double
+__parse_dbl(const char *s, const char *eol)
+{
+/* Decimals with a mantissa of at most 2^53 and a (point-adjusted)
+ * exponent of at most 22 in magnitude are products or quotients of
+ * two doubles that are exact, so the one correctly rounded operation
+ * gives exactly what strtod() gives (Clinger's fast path).
+ * That's all prices and fees we see, the rest goes to strtod(). */
+	static const double e10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+		1e21, 1e22,
+	};
+	const char *p = s;
+	const char *d0;
+	uint_fast64_t w = 0U;
+	size_t nd = 0U;
+	long int e = 0;
+	bool neg = false;
+	double res;
+
+#if !defined FLT_EVAL_METHOD || FLT_EVAL_METHOD != 0
+	/* excess precision would round twice */
+	return __strtod_c(s);
+#endif	/* FLT_EVAL_METHOD */
+	if (p < eol && (*p == '-' || *p == '+')) {
+		neg = *p++ == '-';
+	}
+	if ((d0 = p) + 1 < eol && d0[0U] == '0' && (d0[1U] | 0x20) == 'x') {
+		/* hex floats */
+		return __strtod_c(s);
+	}
+	for (; p < eol && *p >= '0' && *p <= '9'; p++) {
+		if ((nd += w || *p != '0') <= 19U) {
+			w = 10U * w + (*p - '0');
+		}
+	}
+	if (p < eol && *p == '.') {
+		for (p++; p < eol && *p >= '0' && *p <= '9'; p++, e--) {
+			if ((nd += w || *p != '0') <= 19U) {
+				w = 10U * w + (*p - '0');
+			}
+		}
+	}
+	if (p == d0 || (p == d0 + 1U && *d0 == '.')) {
+		/* no digits, inf, nan and whatnot */
+		return __strtod_c(s);
+	}
+	if (p < eol && (*p == 'e' || *p == 'E')) {
+		const char *q = p + 1U;
+		bool eneg = false;
+		long int x = 0;
+
+		if (q < eol && (*q == '-' || *q == '+')) {
+			eneg = *q++ == '-';
+		}
+		/* an e without digits is not part of the number */
+		for (; q < eol && *q >= '0' && *q <= '9'; q++) {
+			if (x < 100000) {
+				x = 10 * x + (*q - '0');
+			}
+		}
+		e += eneg ? -x : x;
+	}
+
+	if (w == 0U) {
+		return neg ? -0.0 : 0.0;
+	} else if (nd > 19U || w > (1ULL << 53U) || e < -22 || e > 22) {
+		return __strtod_c(s);
+	}
+	res = (double)w;
+	res = e < 0 ? res / e10[-e] : res * e10[e];
+	return neg ? -res : res;
+}
+
+static double
+read_tab_double(const char *s, const char *eol)
+{
+	if (s >= eol || *s == '\t') {
+		return 0.0;
+	}
+	return __parse_dbl(s, eol);
+}
+
+static uint_fast64_t
+read_tab_hex(const char *s, const char *eol)
+{
+/* the hex number at S, up to the next tab, 0 if there's none */
+	uint_fast64_t x = 0U;
+
+	for (; s < eol; s++) {
+		unsigned int d = (unsigned char)*s;
+
+		if (d - '0' < 10U) {
+			d -= '0';
+		} else if ((d | 0x20) - 'a' < 6U) {
+			d = (d | 0x20) - 'a' + 10U;
+		} else {
+			break;
+		}
+		x = x << 4U | d;
+	}
+	return x;
+}
+
+static uint_fast64_t
+__sym_hash(const char *s, size_t z)
+{
+/* FNV-1a, symbols are short */
+	uint_fast64_t h = 0xcbf29ce484222325ULL;
+
+	for (size_t i = 0; i < z; i++) {
+		h ^= (unsigned char)s[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static void
+__rehash_sym(durst_ctx_t ctx, size_t nuz)
+{
+	uint32_t *nu = calloc(nuz, sizeof(*nu));
+
+	for (uint32_t k = 0; k < ctx->nsym; k++) {
+		size_t i;
+
+		for (i = ctx->sym[k].h & (nuz - 1U);
+		     nu[i]; i = (i + 1U) & (nuz - 1U));
+		nu[i] = k + 1U;
+	}
+	free(ctx->symh);
+	ctx->symh = nu;
+	ctx->zsymh = nuz;
+	return;
+}
+
+static uint32_t
+__intern(durst_ctx_t ctx, const char *s, size_t z)
+{
+/* return the id of symbol S of length Z, new symbols get the next id */
+	uint_fast64_t h = __sym_hash(s, z);
+	size_t i;
+
+	/* keep the load below one half */
+	if (2U * ((size_t)ctx->nsym + 1U) > ctx->zsymh) {
+		__rehash_sym(ctx, ctx->zsymh ? 2U * ctx->zsymh : 256U);
+	}
+	for (i = h & (ctx->zsymh - 1U);
+	     ctx->symh[i]; i = (i + 1U) & (ctx->zsymh - 1U)) {
+		const struct sym_s *y = ctx->sym + ctx->symh[i] - 1U;
+
+		if (y->h == h && y->z == z && !memcmp(y->s, s, z)) {
+			return ctx->symh[i] - 1U;
+		}
+	}
+	if (ctx->nsym >= ctx->zsym) {
+		ctx->zsym = ctx->zsym ? 2U * ctx->zsym : 256U;
+		ctx->sym = realloc(ctx->sym, ctx->zsym * sizeof(*ctx->sym));
+	}
+	ctx->sym[ctx->nsym] = (struct sym_s){
+		arena_strndup(ctx->sarena, s, z), z, h,
+	};
+	ctx->symh[i] = ++ctx->nsym;
+	return ctx->nsym - 1U;
+}
+
+static uint_fast64_t
+__mkt_hash(const struct __mkt_s *m)
+{
+/* bitwise, so only quotes equal to the last bit are shared */
+	return __sym_hash((const char*)m, sizeof(*m));
+}
+
+static void
+__rehash_mkt(durst_ctx_t ctx, size_t nuz)
+{
+/* index the records still held at size NUZ, the others go to mfree */
+	uint32_t *nu = calloc(nuz, sizeof(*nu));
+
+	ctx->nmkth = 0U;
+	ctx->nmfree = 0U;
+	for (uint32_t k = 0; k < ctx->nmkt; k++) {
+		size_t i;
+
+		if (!__atomic_load_n(&ctx->mkt[k]->nref, __ATOMIC_ACQUIRE)) {
+			ctx->mfree[ctx->nmfree++] = k;
+			continue;
+		}
+		for (i = __mkt_hash(&ctx->mkt[k]->m) & (nuz - 1U);
+		     nu[i]; i = (i + 1U) & (nuz - 1U));
+		nu[i] = k + 1U;
+		ctx->nmkth++;
+	}
+	free(ctx->mkth);
+	ctx->mkth = nu;
+	ctx->zmkth = nuz;
+	return;
+}
+
+static uint32_t
+__intern_mkt(durst_ctx_t ctx, const struct __mkt_s *m)
+{
+/* return the ordinal of quotes M and hold on to it, new quotes are
+ * copied to the store, release with __drop_mkt() */
+	/* -0 and 0 are the same quote */
+	const struct __mkt_s key = {
+		m->stl + 0.0, m->bid + 0.0, m->ask + 0.0,
+	};
+	uint32_t k;
+	size_t i;
+
+	/* keep the load below one half, sweep first, grow if that
+	 * leaves it above a quarter */
+	if (2U * (ctx->nmkth + 1U) > ctx->zmkth) {
+		size_t nuz = ctx->zmkth ? ctx->zmkth : 256U;
+
+		__rehash_mkt(ctx, nuz);
+		if (4U * (ctx->nmkth + 1U) > nuz) {
+			__rehash_mkt(ctx, 2U * nuz);
+		}
+	}
+	for (i = __mkt_hash(&key) & (ctx->zmkth - 1U);
+	     ctx->mkth[i]; i = (i + 1U) & (ctx->zmkth - 1U)) {
+		struct mkt_s *r = ctx->mkt[ctx->mkth[i] - 1U];
+
+		if (!memcmp(&r->m, &key, sizeof(key))) {
+			__atomic_add_fetch(&r->nref, 1U, __ATOMIC_RELAXED);
+			return ctx->mkth[i] - 1U;
+		}
+	}
+	if (ctx->nmfree > 0U) {
+		k = ctx->mfree[--ctx->nmfree];
+	} else {
+		if (ctx->nmkt >= ctx->zmkt) {
+			ctx->zmkt = ctx->zmkt ? 2U * ctx->zmkt : 256U;
+			ctx->mkt = realloc(
+				ctx->mkt, ctx->zmkt * sizeof(*ctx->mkt));
+			ctx->mfree = realloc(
+				ctx->mfree, ctx->zmkt * sizeof(*ctx->mfree));
+		}
+		k = ctx->nmkt++;
+		ctx->mkt[k] = arena_alloc(ctx->marena, sizeof(*ctx->mkt[k]));
+	}
+	ctx->mkt[k]->m = key;
+	ctx->mkt[k]->nref = 1U;
+	ctx->mkth[i] = k + 1U;
+	ctx->nmkth++;
+	return k;
+}
+
+static void*
+__grow(arena_t a, void *ary, size_t *z, size_t n, size_t sz)
+{
+/* make room for one more element of size SZ behind N in ARY,
+ * the old array is left behind in the arena */
+	if (n >= *z) {
+		size_t nuz = *z ? 2U * *z : 16U;
+		void *nu = arena_alloc(a, nuz * sz);
+
+		if (n > 0U) {
+			memcpy(nu, ary, n * sz);
+		}
+		memset((char*)nu + n * sz, 0, (nuz - n) * sz);
+		ary = nu;
+		*z = nuz;
+	}
+	return ary;
+}
+
+static void
+pf_hold_mkt(pf_t pf, struct mkt_s *r)
+{
+/* R is held already, let PF drop it when it's freed */
+	pf->mref = __grow(pf->arena, pf->mref, &pf->zmref,
+			  pf->nmref, sizeof(*pf->mref));
+	pf->mref[pf->nmref++] = r;
+	return;
+}
+
+static const struct __mkt_s*
+pf_share_mkt(pf_t pf, const struct __mkt_s *m)
+{
+	uint32_t k = __intern_mkt(pf->ctx, m);
+	struct mkt_s *r = pf->ctx->mkt[k];
+
+	pf_hold_mkt(pf, r);
+	return &r->m;
+}
+
+static struct quo_s*
+__quo(durst_ctx_t ctx, uint32_t id)
+{
+/* the quote table slot of symbol ID, naught quotes if it's new */
+	if (id >= ctx->zquo) {
+		size_t nuz = ctx->zquo ? ctx->zquo : 256U;
+
+		for (; nuz <= id; nuz *= 2U);
+		ctx->quo = realloc(ctx->quo, nuz * sizeof(*ctx->quo));
+		memset(ctx->quo + ctx->zquo, 0,
+		       (nuz - ctx->zquo) * sizeof(*ctx->quo));
+		ctx->zquo = nuz;
+	}
+	if (ctx->quo[id].mkt == NULL) {
+		ctx->quo[id].mkt = arena_calloc(
+			ctx->marena, 1U, sizeof(*ctx->quo[id].mkt));
+	}
+	return ctx->quo + id;
+}
+
+static const struct quo_s*
+find_quo(durst_ctx_t ctx, const struct __hdr_s *h)
+{
+	if (h->id < ctx->zquo && ctx->quo[h->id].setp) {
+		return ctx->quo + h->id;
+	}
+	return NULL;
+}
+
+static const struct __mkt_s*
+__join_quo(durst_ctx_t ctx, const struct __hdr_s *h)
+{
+/* quotes of H from the quote table, they may yet be set */
+	return __quo(ctx, h->id)->mkt;
+}
+
+static void
+__parse_sym(pf_t pf, struct __hdr_s *h, const char *s, const char *p)
+{
+/* the field from S up to P, behind its tab, is the symbol of H,
+ * point into the input mapping if it's there */
+	const struct map_s *m = pf->map;
+	size_t z = __field_len(s, p);
+
+	if (m != NULL && s >= m->p && s < m->p + m->z) {
+		h->sym = s;
+	} else {
+		h->sym = arena_strndup(pf->arena, s, z);
+	}
+	h->symz = z;
+	h->id = __intern(pf->ctx, s, z);
+	return;
+}
+
+static int
+__parse_fut(durst_ctx_t ctx, pf_t pf, urs_fut_pos_t fp,
+	    const char *line, const char *eol)
+{
+/* FUT name ccy pos fbid fask fstl rbid rask rstl lo tgt hi fee
+ * or without fbid fask fstl when joining quotes */
+	struct __mkt_s fm;
+	const char *p;
+
+	p = __skip_behind_tab(line, eol);
+
+	/* frob sym */
+	line = p;
+	p = __skip_behind_tab(line, eol);
+	__parse_sym(pf, &fp->hdr, line, p);
+
+	/* frob ccy */
+	line = p;
+	p = __skip_behind_tab(line, eol);
+	fp->ccy = __find_4217(ctx, line, __field_len(line, p));
+
+	/* frob pos */
+	line = p;
+	if ((fp->mult = read_tab_double(line, eol)) == 0.0) {
+		fp->mult = 1;
+	}
+
+	/* frob soft_pos */
+	line = __skip_behind_tab(p, eol);
+	fp->pos.soft = read_tab_double(p = line, eol);
+
+	/* frob hard_pos */
+	line = __skip_behind_tab(p, eol);
+	fp->pos.hard = read_tab_double(p = line, eol);
+
+	if (ctx->qjoin) {
+		fp->f_mkt = __join_quo(ctx, &fp->hdr);
+		goto sbid;
+	}
+
+	/* frob fbid */
+	line = __skip_behind_tab(p, eol);
+	fm.bid = read_tab_double(p = line, eol);
+
+	/* frob fask */
+	line = __skip_behind_tab(p, eol);
+	fm.ask = read_tab_double(p = line, eol);
+
+	/* frob fstl */
+	line = __skip_behind_tab(p, eol);
+	fm.stl = read_tab_double(p = line, eol);
+	fp->f_mkt = pf_share_mkt(pf, &fm);
+
+sbid:
+	/* frob sbid */
+	line = __skip_behind_tab(p, eol);
+	fp->s_mkt.bid = read_tab_double(p = line, eol);
+
+	/* frob sask */
+	line = __skip_behind_tab(p, eol);
+	fp->s_mkt.ask = read_tab_double(p = line, eol);
+
+	/* frob sstl */
+	line = __skip_behind_tab(p, eol);
+	fp->s_mkt.stl = read_tab_double(p = line, eol);
+
+	/* frob lo */
+	line = __skip_behind_tab(p, eol);
+	fp->band.lo = read_tab_double(p = line, eol);
+
+	/* frob tgt */
+	line = __skip_behind_tab(p, eol);
+	fp->band.med = read_tab_double(p = line, eol);
+
+	/* frob hi */
+	line = __skip_behind_tab(p, eol);
+	fp->band.hi = read_tab_double(p = line, eol);
+
+	/* convenience check */
+	if (fp->band.lo > fp->band.hi) {
+		double tmp = fp->band.lo;
+		fp->band.lo = fp->band.hi;
+		fp->band.hi = tmp;
+	}
+
+	/* frob fee */
+	line = __skip_behind_tab(p, eol);
+	fp->fee = read_tab_double(p = line, eol);
+
+	return 0;
+}
+
+static int
+__parse_cash(durst_ctx_t ctx, pf_t pf, urs_cash_pos_t cp,
+	     const char *line, const char *eol)
+{
+/* CASH name soft_pos hard_pos bid ask stl lo med hi soft_fee hard_fee
+ * or without bid ask stl when joining quotes */
+	struct __mkt_s sm;
+	const char *p;
+	size_t z;
+
+	p = __skip_behind_tab(line, eol);
+
+	/* frob sym */
+	line = p;
+	p = __skip_behind_tab(line, eol);
+	__parse_sym(pf, &cp->hdr, line, p);
+
+	/* frob ccy */
+	line = p;
+	p = __skip_behind_tab(line, eol);
+	z = __field_len(line, p);
+	if ((cp->tccy = __find_4217(ctx, line, z)) == NULL) {
+		cp->tccy = __add_4217(ctx, line, z);
+	}
+
+	/* frob soft */
+	line = p;
+	cp->soft_ini = cp->term.soft = read_tab_double(p = line, eol);
+
+	/* frob hard */
+	line = __skip_behind_tab(p, eol);
+	cp->hard_ini = cp->term.hard = read_tab_double(p = line, eol);
+
+	/* set the fx slot for convenience */
+	cp->forex_ini = 0.0;
+
+	if (ctx->qjoin) {
+		cp->s_mkt = __join_quo(ctx, &cp->hdr);
+		goto lo;
+	}
+
+	/* frob bid */
+	line = __skip_behind_tab(p, eol);
+	sm.bid = read_tab_double(p = line, eol);
+
+	/* frob ask */
+	line = __skip_behind_tab(p, eol);
+	sm.ask = read_tab_double(p = line, eol);
+
+	/* frob stl */
+	line = __skip_behind_tab(p, eol);
+	sm.stl = read_tab_double(p = line, eol);
+	cp->s_mkt = pf_share_mkt(pf, &sm);
+
+lo:
+	/* frob lo */
+	line = __skip_behind_tab(p, eol);
+	cp->band.lo = read_tab_double(p = line, eol);
+
+	/* frob tgt */
+	line = __skip_behind_tab(p, eol);
+	cp->band.med = read_tab_double(p = line, eol);
+
+	/* frob hi */
+	line = __skip_behind_tab(p, eol);
+	cp->band.hi = read_tab_double(p = line, eol);
+
+	/* frob soft fee */
+	line = __skip_behind_tab(p, eol);
+	cp->soft_fee = read_tab_double(p = line, eol);
+
+	/* frob fee */
+	line = __skip_behind_tab(p, eol);
+	cp->hard_fee = read_tab_double(p = line, eol);
+
+	return 0;
+}
+
+static int
+__parse_nav(durst_ctx_t ctx, urs_nav_pos_t np,
+	    const char *line, const char *eol)
+{
+/* CASH name soft_pos hard_pos bid ask stl lo med hi soft_fee hard_fee */
+	const char *p;
+	size_t z;
+
+	p = __skip_behind_tab(line, eol);
+
+	/* frob sym, we just set it to NAV */
+	line = p;
+	np->hdr = (struct __hdr_s){"NAV", 3U, URS_NOSYM};
+
+	/* frob ccy */
+	p = __skip_behind_tab(line, eol);
+	z = __field_len(line, p);
+	if ((np->tccy = __find_4217(ctx, line, z)) == NULL) {
+		np->tccy = __add_4217(ctx, line, z);
+	}
+
+	/* frob soft */
+	line = p;
+	np->soft_ini = np->base.soft = read_tab_double(p = line, eol);
+
+	/* frob hard */
+	line = __skip_behind_tab(p, eol);
+	np->hard_ini = np->base.hard = read_tab_double(p = line, eol);
+	return 0;
+}
+
+static int
+__parse_model(const char *line, const char *eol)
+{
+/* MODEL roland|fee-aware, return the durst_model_t or -1 */
+	static const char rol[] = "roland";
+	static const char fee[] = "fee-aware";
+	const char *p = __skip_behind_tab(line, eol);
+	size_t z;
+
+	for (z = eol - p; z > 0 && (p[z - 1] == '\n' || p[z - 1] == '\r' ||
+				    p[z - 1] == '\t' || p[z - 1] == ' '); z--);
+	if (z == sizeof(rol) - 1 && memcmp(p, rol, z) == 0) {
+		return DURST_MODEL_ROLAND;
+	} else if (z == sizeof(fee) - 1 && memcmp(p, fee, z) == 0) {
+		return DURST_MODEL_FEE_AWARE;
+	}
+	return -1;
+}
+
+static const char*
+__parse_pfid(const char *line, const char *eol)
+{
+/* return the id of a PORTFOLIO record, or NULL if LINE is none */
+	static const char pfrec[] = "PORTFOLIO";
+
+	if (strncmp(line, pfrec, sizeof(pfrec) - 1) != 0) {
+		return NULL;
+	}
+	line += sizeof(pfrec) - 1;
+	if (line < eol && *line != '\t' && *line != ' ' &&
+	    *line != '\r' && *line != '\n') {
+		/* PORTFOLIOxyz is no PORTFOLIO record */
+		return NULL;
+	}
+	for (; line < eol && (*line == '\t' || *line == ' '); line++);
+	return line;
+}
+
+static size_t
+__pfid_len(const char *id, const char *eol)
+{
+/* the length of the id at ID with line endings chopped off */
+	size_t idz = eol - id;
+
+	while (idz > 0 && (id[idz - 1] == '\n' ||
+			   id[idz - 1] == '\r' ||
+			   id[idz - 1] == '\t' ||
+			   id[idz - 1] == ' ')) {
+		idz--;
+	}
+	return idz;
+}
+
+static int
+rdr_map(struct rdr_s *r)
+{
+/* map the rest of WHENCE if it's a regular file, pipes and the like
+ * are read line by line */
+	struct stat st;
+	int fd = fileno(r->whence);
+	off_t off;
+	void *p;
+
+	if (fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+		return -1;
+	} else if ((off = ftello(r->whence)) < 0 || off >= st.st_size) {
+		return -1;
+	}
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		return -1;
+	}
+	madvise(p, st.st_size, MADV_SEQUENTIAL);
+
+	r->map = malloc(sizeof(*r->map));
+	r->map->p = p;
+	r->map->z = st.st_size;
+	r->map->nref = 1U;
+	r->mp = r->map->p + off;
+	r->me = r->map->p + st.st_size;
+	/* as far as stdio's concerned we've read it all */
+	fseeko(r->whence, 0, SEEK_END);
+	return 0;
+}
+
+static const char*
+rdr_line(struct rdr_s *r, const char **eol)
+{
+/* return the next line and set EOL to its end, i.e. the newline,
+ * or return NULL if there's no more lines */
+	ssize_t nrd;
+
+	if (r->map != NULL) {
+		const char *bol = r->mp;
+		const char *nl;
+		size_t z;
+
+		if (bol >= r->me) {
+			return NULL;
+		} else if ((nl = memchr(bol, '\n', r->me - bol)) != NULL) {
+			r->mp = nl + 1U;
+			*eol = nl;
+			return bol;
+		}
+		/* last line without newline, copy it so that there's
+		 * a terminator for the number parsers */
+		if ((z = r->me - bol) >= r->llen) {
+			r->llen = z + 1U;
+			r->line = realloc(r->line, r->llen);
+		}
+		memcpy(r->line, bol, z);
+		r->line[z] = '\0';
+		r->mp = r->me;
+		*eol = r->line + z;
+		return r->line;
+	}
+	if ((nrd = getline(&r->line, &r->llen, r->whence)) == -1) {
+		return NULL;
+	}
+	*eol = r->line + nrd - (nrd > 0 && r->line[nrd - 1] == '\n');
+	return r->line;
+}
+
+static pf_t
+read_pf(durst_ctx_t ctx)
+{
+/* read positions up to the next PORTFOLIO record or the end of input,
+ * return NULL if there's nothing more to read */
+	struct rdr_s *r = &ctx->rdr;
+	pf_t res = NULL;
+	const char *line;
+	const char *eol;
+
+	/* read line by line */
+	if (r->whence == NULL) {
+		return NULL;
+	}
+
+	res = make_pf(ctx);
+	if (r->map != NULL) {
+		res->map = map_ref(r->map);
+	}
+	if (r->nidp) {
+		res->id = arena_strndup(res->arena, r->nid, r->znid);
+		r->nidp = false;
+	}
+
+	while ((line = rdr_line(r, &eol)) != NULL) {
+		posty_t pty = __parse_posty(line);
+		const char *id;
+
+		if ((id = __parse_pfid(line, eol)) != NULL) {
+			size_t idz = __pfid_len(id, eol);
+
+			if (res->nposs > 0 || res->id != NULL) {
+				/* that's the start of the next portfolio */
+				if (idz >= r->znid) {
+					r->znid = idz + 1U;
+					r->nid = realloc(r->nid, r->znid);
+				}
+				memcpy(r->nid, id, idz);
+				r->nid[idz] = '\0';
+				r->nidp = true;
+				break;
+			}
+			/* leading record, use it for this portfolio */
+			res->id = arena_strndup(res->arena, id, idz);
+			continue;
+		}
+
+		res->poss = __grow(res->arena, res->poss, &res->zposs,
+				   res->nposs, sizeof(*res->poss));
+		switch (pty) {
+		case POSTY_CASH:
+			res->cash = __grow(res->arena, res->cash, &res->zcash,
+					   res->ncash, sizeof(*res->cash));
+			if (__parse_cash(ctx, res, res->cash + res->ncash,
+					 line, eol) == 0) {
+				res->poss[res->nposs].ty = pty;
+				res->poss[res->nposs++].i = res->ncash++;
+			}
+			break;
+		case POSTY_FUT:
+			res->fut = __grow(res->arena, res->fut, &res->zfut,
+					  res->nfut, sizeof(*res->fut));
+			if (__parse_fut(ctx, res, res->fut + res->nfut,
+					line, eol) == 0) {
+				res->poss[res->nposs].ty = pty;
+				res->poss[res->nposs++].i = res->nfut++;
+			}
+			break;
+		case POSTY_NAV: {
+			/* nav records just preset the portfolio value */
+			struct __nav_pos_s nav;
+
+			if (__parse_nav(ctx, &nav, line, eol) == 0) {
+				res->val_ini.soft = nav.base.soft;
+				res->val_ini.hard = nav.base.hard;
+			}
+			break;
+		}
+		case POSTY_MODEL: {
+			/* model records pick the futures model */
+			int m;
+
+			if ((m = __parse_model(line, eol)) >= 0) {
+				res->model = m;
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	if (r->npf > 0 && res->nposs == 0 && res->id == NULL) {
+		/* nothing left */
+		free_pf(res);
+		return NULL;
+	}
+	r->npf++;
+	res->seq = ctx->npf++;
+	res->nsym = ctx->nsym;
+	index_pf(res);
+	return res;
+}
+
+static void
+free_rdr(struct rdr_s *r)
+{
+	if (r->line != NULL) {
+		free(r->line);
+	}
+	if (r->nid != NULL) {
+		free(r->nid);
+	}
+	if (r->map != NULL) {
+		map_unref(r->map);
+	}
+	memset(r, 0, sizeof(*r));
+	return;
+}
+
+static int
+data_complete_p(pf_t pf)
+{
+/* check if for all non-0 positions we have market data */
+	for (size_t i = 0; i < pf->ncash; i++) {
+		urs_cash_pos_t cp = pf->cash + i;
+		if ((cp->term.soft != 0.0 || cp->term.hard != 0.0) &&
+		    cp->s_mkt->stl == 0.0) {
+			return 0;
+		}
+	}
+	for (size_t i = 0; i < pf->nfut; i++) {
+		urs_fut_pos_t fp = pf->fut + i;
+		if ((fp->pos.soft != 0.0 || fp->pos.hard != 0.0) &&
+		    fp->f_mkt->stl == 0.0) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
+
+static double
+__work_pass(pf_t pf, double nav)
+{
+/* rebalance at NAV and return the nav that results, trades are kept
+ * in the frozen cash positions for reco_poss_thaw(), every position is
+ * checked against its band in one sweep and those in breach are
+ * rebalanced, cash positions are then settled off a worklist */
+	double res;
+
+	reba_relanav(pf, nav);
+	/* cash assets constitute the nav as well, option? */
+	res = compute_pf_val(pf);
+	reco_poss_settle(pf);
+	return res;
+}
+
+static void
+__work_init(pf_t pf)
+{
+/* the first pass settles all cash positions and has resized nothing */
+	memset(pf->cc.wl, 0xff, (pf->ncash / 64U) * sizeof(*pf->cc.wl));
+	pf->cc.wl[pf->ncash / 64U] = (1ULL << (pf->ncash % 64U)) - 1U;
+	memset(pf->cc.tch, 0, (pf->ncash / 64U + 1U) * sizeof(*pf->cc.tch));
+	memset(pf->fc.rsz, 0, (pf->nfut / 64U + 1U) * sizeof(*pf->fc.rsz));
+	return;
+}
+
+static bool
+warm_replay(pf_t pf, const struct wst_s *w)
+{
+/* redo the last pass of W, with the futures as it left them nothing
+ * gets resized at the nav that pass was at, so if that yields the nav
+ * W settled on the passes before would have led there as well,
+ * otherwise put the book back the way it was */
+	const struct urs_fut_kern_s *fk = pf_fk(pf);
+
+	if (pf->fut1 == NULL) {
+		pf->fut1 = arena_alloc(
+			pf->arena, pf->nfut * sizeof(*pf->fut) + 1U);
+		pf->cash1 = arena_alloc(
+			pf->arena, pf->ncash * sizeof(*pf->cash) + 1U);
+	}
+	if (pf->nfut > 0U) {
+		memcpy(pf->fut1, pf->fut, pf->nfut * sizeof(*pf->fut));
+	}
+	if (pf->ncash > 0U) {
+		memcpy(pf->cash1, pf->cash, pf->ncash * sizeof(*pf->cash));
+	}
+	for (size_t i = 0; i < pf->nfut; i++) {
+		if (!isnan(pf->wfut[i])) {
+			pf->fut[i].pos.soft = pf->wfut[i];
+			fk->settle(pf->fut + i);
+			fut_col_put(pf, i);
+			pf->fc.rsz[i / 64U] |= 1ULL << (i % 64U);
+		}
+	}
+	if (__work_pass(pf, w->nav_try) == w->nav) {
+		return true;
+	}
+	URS_DEBUG("WARM START MISSED\n");
+	if (pf->nfut > 0U) {
+		memcpy(pf->fut, pf->fut1, pf->nfut * sizeof(*pf->fut));
+	}
+	if (pf->ncash > 0U) {
+		memcpy(pf->cash, pf->cash1, pf->ncash * sizeof(*pf->cash));
+	}
+	cols_put(pf);
+	__work_init(pf);
+	return false;
+}
+
+static void
+__work(pf_t pf, const struct wst_s *w)
+{
+/* find the nav that rebalancing at it yields by fixed-point steps,
+ * futures keep the size they got at the nav they were last breached,
+ * a warm start W of the very same book skips to the last step */
+	const double tol = 0.01;
+	const size_t max_steps = 10;
+	double old_nav;
+	double new_nav;
+
+	URS_DEBUG("rebalancing ...\n");
+
+	__work_init(pf);
+	reco_poss_freeze(pf);
+	/* cash assets constitute the nav as well, option? */
+	old_nav = compute_pf_val(pf);
+	reco_poss_reset(pf);
+
+	pf->nav_fix = pf->nav_try = old_nav;
+	pf->resid = 0.0;
+	if (reba_relanav_check(pf, old_nav)) {
+		/* everything's in its band, nothing to do */
+		URS_DEBUG("NO REBA NEEDED\n");
+		pf->niter = 0U;
+		return;
+	}
+
+	if (w != NULL && w->book == pf->book && warm_replay(pf, w)) {
+		old_nav = w->nav_try;
+		new_nav = w->nav;
+		pf->niter = 1U;
+	} else {
+		new_nav = __work_pass(pf, old_nav);
+		for (pf->niter = 1U; pf->niter <= max_steps; pf->niter++) {
+			if (fabs(new_nav - old_nav) <= tol) {
+				break;
+			}
+			old_nav = new_nav;
+			new_nav = __work_pass(pf, old_nav);
+			URS_DEBUG("OLD v NEW %.4f v %.4f\n", old_nav, new_nav);
+		}
+	}
+	pf->resid = fabs(new_nav - old_nav);
+	pf->nav_fix = new_nav;
+	pf->nav_try = old_nav;
+
+	/* what the next run needs to start off here */
+	if (pf->lfut == NULL) {
+		pf->lfut = arena_alloc(pf->arena, (pf->nfut + 1U) * sizeof(double));
+	}
+	for (size_t i = 0; i < pf->nfut; i++) {
+		pf->lfut[i] = pf->fc.rsz[i / 64U] >> (i % 64U) & 1U
+			? pf->fut[i].pos.soft : NAN;
+	}
+
+	/* reconciliation, could be a CLI option */
+	reco_poss_thaw(pf);
+	/* now after thawing iterate over the portfolio to get the cash
+	 * balances right */
+	reba_relanav(pf, new_nav);
+	return;
+}
+
+
+/* warm starts, the nav a portfolio settled on in the last run and the
+ * trades in its futures, rebalancing starts off there */
+static struct wst_s*
+find_wst(durst_ctx_t ctx, const char *id, size_t idz)
+{
+	const uint_fast64_t h = __sym_hash(id, idz);
+
+	if (ctx->zwsth == 0U) {
+		return NULL;
+	}
+	for (size_t i = h & (ctx->zwsth - 1U);
+	     ctx->wsth[i]; i = (i + 1U) & (ctx->zwsth - 1U)) {
+		struct wst_s *w = ctx->wst + ctx->wsth[i] - 1U;
+
+		if (w->h == h && w->idz == idz && !memcmp(w->id, id, idz)) {
+			return w;
+		}
+	}
+	return NULL;
+}
+
+static struct wst_s*
+__wst(durst_ctx_t ctx, const char *id, size_t idz)
+{
+/* the warm start of portfolio ID, a fresh one if there's none yet */
+	struct wst_s *w;
+	size_t i;
+
+	if ((w = find_wst(ctx, id, idz)) != NULL) {
+		return w;
+	}
+	/* keep the load below one half */
+	if (2U * (ctx->nwst + 1U) > ctx->zwsth) {
+		size_t nuz = ctx->zwsth ? 2U * ctx->zwsth : 64U;
+		uint32_t *nu = calloc(nuz, sizeof(*nu));
+
+		for (size_t k = 0; k < ctx->nwst; k++) {
+			for (i = ctx->wst[k].h & (nuz - 1U);
+			     nu[i]; i = (i + 1U) & (nuz - 1U));
+			nu[i] = k + 1U;
+		}
+		free(ctx->wsth);
+		ctx->wsth = nu;
+		ctx->zwsth = nuz;
+	}
+	if (ctx->nwst >= ctx->zwst) {
+		ctx->zwst = ctx->zwst ? 2U * ctx->zwst : 64U;
+		ctx->wst = realloc(ctx->wst, ctx->zwst * sizeof(*ctx->wst));
+	}
+	w = ctx->wst + ctx->nwst;
+	*w = (struct wst_s){
+		arena_strndup(ctx->sarena, id, idz), idz, __sym_hash(id, idz),
+		.nav = NAN,
+	};
+	for (i = w->h & (ctx->zwsth - 1U);
+	     ctx->wsth[i]; i = (i + 1U) & (ctx->zwsth - 1U));
+	ctx->wsth[i] = ++ctx->nwst;
+	return w;
+}
+
+static inline uint_fast64_t
+__fold(uint_fast64_t h, uint64_t u)
+{
+	h = (h ^ u) * 0x100000001b3ULL;
+	return h ^ h >> 32U;
+}
+
+static uint_fast64_t
+__fold_dbl(uint_fast64_t h, const void *p, size_t z)
+{
+/* fold the doubles in the Z bytes at P into H, bit for bit */
+	const char *s = p;
+
+	for (size_t i = 0; i + sizeof(uint64_t) <= z; i += sizeof(uint64_t)) {
+		uint64_t u;
+
+		memcpy(&u, s + i, sizeof(u));
+		h = __fold(h, u);
+	}
+	return h;
+}
+
+static uint_fast64_t
+__ccy_hash(const_pfack_4217_t ccy)
+{
+	return ccy != NULL ? __sym_hash(ccy->sym, strnlen(ccy->sym, 4U)) : 0U;
+}
+
+static uint_fast64_t
+book_digest(pf_t pf)
+{
+/* a digest of everything rebalancing PF goes by, symbols rather than
+ * ids as those depend on the order things were read in, a warm start
+ * is no good for any other book */
+	uint_fast64_t h = __ccy_hash(pf->bccy);
+
+	h = __fold(h, pf_fk(pf) - urs_fut_kern);
+	h = __fold(h, pf->ctx->sum);
+	h = __fold_dbl(h, &pf->val_ini, sizeof(pf->val_ini));
+	for (size_t i = 0; i < pf->nfut; i++) {
+		const struct __fut_pos_s *fp = pf->fut + i;
+
+		h = __fold(h, __sym_hash(fp->hdr.sym, fp->hdr.symz));
+		h = __fold_dbl(h, &fp->pos, sizeof(fp->pos));
+		h = __fold_dbl(h, fp->f_mkt, sizeof(*fp->f_mkt));
+		/* s_mkt through val_fac are all doubles */
+		h = __fold_dbl(h, &fp->s_mkt,
+			       (const char*)(&fp->val_fac + 1U) -
+			       (const char*)&fp->s_mkt);
+		h = __fold(h, __ccy_hash(fp->ccy));
+	}
+	for (size_t i = 0; i < pf->ncash; i++) {
+		const struct __cash_pos_s *cp = pf->cash + i;
+
+		h = __fold(h, __sym_hash(cp->hdr.sym, cp->hdr.symz));
+		h = __fold(h, __ccy_hash(cp->tccy));
+		h = __fold_dbl(h, cp->s_mkt, sizeof(*cp->s_mkt));
+		h = __fold(h, (uint64_t)cp->dir);
+		/* term through hard_fee are all doubles */
+		h = __fold_dbl(h, &cp->term,
+			       (const char*)(&cp->hard_fee + 1U) -
+			       (const char*)&cp->term);
+		h = __fold_dbl(h, &cp->band, sizeof(cp->band));
+		h = __fold(h, cp->bp != NULL ? cp->bp - pf->cash + 1 : 0);
+	}
+	return h;
+}
+
+static const struct wst_s*
+warm_find(pf_t pf)
+{
+/* look up PF's warm start and line its futures up with it, the state
+ * was written in the order of the futures so mostly they're in place,
+ * the warm starts may have been read anew since the last time */
+	const char *id = pf->id != NULL ? pf->id : "";
+	const struct wst_s *w;
+
+	if ((w = find_wst(pf->ctx, id, strlen(id))) == NULL) {
+		return NULL;
+	}
+	if (pf->wfut == NULL) {
+		pf->wfut = arena_alloc(
+			pf->arena, (pf->nfut + 1U) * sizeof(double));
+	}
+	for (size_t i = 0, j = 0; i < pf->nfut; i++) {
+		const uint32_t sym = pf->fut[i].hdr.id;
+
+		pf->wfut[i] = NAN;
+		if (j < w->nfut && w->fsym[j] == sym) {
+			pf->wfut[i] = w->fsoft[j++];
+			continue;
+		}
+		for (size_t k = 0; k < w->nfut; k++) {
+			if (w->fsym[k] == sym) {
+				pf->wfut[i] = w->fsoft[k];
+				j = k + 1U;
+				break;
+			}
+		}
+	}
+	return w;
+}
+
+
+/* incremental valuation, quotes that changed since the last update only
+ * touch the positions quoted in them and the futures valued by them, and
+ * band checks are redone for those alone as long as the nav stays within
+ * the range where no other position can change sides of its band */
+#define INC_SLACK	(1e-9)
+
+static const struct __hdr_s*
+pos_hdr(pos_t p)
+{
+	switch (p->ty) {
+	case POSTY_FUT:
+		return &p->fut->hdr;
+	case POSTY_CASH:
+		return &p->cash->hdr;
+	default:
+		return NULL;
+	}
+}
+
+static inline size_t
+__six_hash(uint32_t id)
+{
+	return (size_t)(id * 0x9e3779b1U);
+}
+
+static void
+inc_index(pf_t pf)
+{
+	for (pf->zsix = 16U; pf->zsix < 2U * pf->nposs; pf->zsix *= 2U);
+	pf->six = arena_calloc(pf->arena, pf->zsix, sizeof(*pf->six));
+	pf->dirt = arena_calloc(pf->arena, pf->nposs + 1U, sizeof(*pf->dirt));
+
+	for (size_t k = 0; k < pf->nposs; k++) {
+		const struct __hdr_s *h = pos_hdr(pf->poss + k);
+		size_t i;
+
+		if (h == NULL || h->id == URS_NOSYM) {
+			continue;
+		}
+		for (i = __six_hash(h->id) & (pf->zsix - 1U);
+		     pf->six[i].id1; i = (i + 1U) & (pf->zsix - 1U));
+		pf->six[i] = (struct six_s){h->id + 1U, (uint32_t)k};
+	}
+	return;
+}
+
+static void
+inc_range(pf_t pf, double x, double stl, double lo, double hi, double q)
+{
+/* narrow the range of nav_ref / nav within which X, the position
+ * valued at nav_ref, stays on the side of the band LO..HI that it is
+ * on at nav_ref / nav = Q */
+	const double r = x / (pf->nav_ref * stl);
+	double a;
+	double b;
+
+	if (r == 0.0) {
+		/* no nav makes a difference */
+		return;
+	} else if (isnan(r)) {
+		pf->qlo = INFINITY;
+		pf->qhi = -INFINITY;
+		return;
+	}
+	/* within the band iff nav_ref / nav is in [a, b] */
+	a = r > 0.0 ? lo / r : hi / r;
+	b = r > 0.0 ? hi / r : lo / r;
+	if (q < a) {
+		b = a;
+		a = -INFINITY;
+	} else if (q > b) {
+		a = b;
+		b = INFINITY;
+	}
+	/* stay clear of rounding, with infinite A or B this yields NaN
+	 * which fmax() and fmin() ignore */
+	pf->qlo = fmax(pf->qlo, a + fabs(a) * INC_SLACK);
+	pf->qhi = fmin(pf->qhi, b - fabs(b) * INC_SLACK);
+	return;
+}
+
+static void
+inc_full(pf_t pf)
+{
+	const struct fut_col_s *fc = &pf->fc;
+	const struct cash_col_s *cc = &pf->cc;
+	const double nav = compute_pf_val(pf);
+
+	pf->nbrk = kern_breach(fc->brk, fc->pos, fc->stl, nav,
+			       fc->lo, fc->hi, pf->nfut);
+	pf->nbrk += kern_breach(cc->brk, cc->pos, cc->stl, nav,
+				cc->lo, cc->hi, pf->ncash);
+
+	pf->nav_ref = nav;
+	pf->qlo = 0.0;
+	pf->qhi = INFINITY;
+	for (size_t i = 0; i < pf->nfut; i++) {
+		inc_range(pf, fc->pos[i], fc->stl[i],
+			  fc->lo[i], fc->hi[i], 1.0);
+	}
+	for (size_t i = 0; i < pf->ncash; i++) {
+		inc_range(pf, cc->pos[i], cc->stl[i],
+			  cc->lo[i], cc->hi[i], 1.0);
+	}
+	inc_drop(pf);
+	pf->qlog = pf->ctx->qbase + pf->ctx->nqlog;
+	pf->incp = true;
+	pf->ctx->ninc++;
+	return;
+}
+
+static void
+inc_check(pf_t pf, uint64_t *brk, size_t i,
+	  double x, double stl, double lo, double hi, double nav)
+{
+/* recheck position I against its band, as reba_relanav_check() would */
+	const double r = x / (nav * stl);
+	const uint64_t b = r < lo || r > hi;
+	const uint64_t o = brk[i / 64U] >> (i % 64U) & 1U;
+
+	brk[i / 64U] ^= (b ^ o) << (i % 64U);
+	pf->nbrk += b - o;
+	inc_range(pf, x, stl, lo, hi, pf->nav_ref / nav);
+	return;
+}
+
+static int
+inc_cash(pf_t pf, urs_cash_pos_t cp, size_t *nd)
+{
+/* revalue cash position CP at its current rate, and the futures valued
+ * at it, return -1 if that's better left to a full revaluation */
+	struct fut_col_s *fc = &pf->fc;
+	struct cash_col_s *cc = &pf->cc;
+	const size_t i = cp - pf->cash;
+	const double ostl = cc->stl[i];
+	const double nstl = cp->s_mkt->stl;
+	struct ccy_grp_s *g;
+
+	if (!memcmp(&ostl, &nstl, sizeof(ostl))) {
+		return 0;
+	} else if (ostl == 0.0 || nstl == 0.0 || !isfinite(nstl)) {
+		/* this changes which futures count at all */
+		return -1;
+	}
+	cc->stl[i] = nstl;
+	if (pf->val_ini.hard == 0.0) {
+		const double ovs = cc->vs[i];
+		const double ovh = cc->vh[i];
+
+		cc->vs[i] = cc->soft[i] / nstl + cc->fx[i] / nstl;
+		cc->vh[i] = cc->hard[i] / nstl;
+		pf->val.soft += cc->vs[i] - ovs;
+		pf->val.hard += cc->vh[i] - ovh;
+	}
+	pf->dirt[(*nd)++] = pf->nfut + i;
+
+	if ((g = find_ccy_grp(pf, cp->tccy)) == NULL ||
+	    (cp != g->cash && cp != g->last)) {
+		return 0;
+	}
+	for (size_t j = g->fut; j != NOFUT; j = fc->nx[j]) {
+		const double ovh = fc->vh[j];
+
+		if (cp == g->last && cp->tccy != pf->bccy) {
+			pf->fut[j].val_fac = nstl;
+		}
+		fut_col_put(pf, j);
+		fc->vh[j] = fc->hard[j] / fc->val_fac[j];
+		pf->val.hard += fc->vh[j] - ovh;
+		if (*nd >= pf->nposs) {
+			return -1;
+		}
+		pf->dirt[(*nd)++] = j;
+	}
+	return 0;
+}
+
+static int
+inc_quote(pf_t pf, uint32_t id, size_t *nd)
+{
+/* account for the new quotes of symbol ID */
+	durst_ctx_t ctx = pf->ctx;
+	const struct quo_s *q = ctx->quo + id;
+
+	for (size_t i = __six_hash(id) & (pf->zsix - 1U);
+	     pf->six[i].id1; i = (i + 1U) & (pf->zsix - 1U)) {
+		pos_t p = pf->poss + pf->six[i].k;
+
+		if (pf->six[i].id1 != id + 1U) {
+			continue;
+		}
+		switch (p->ty) {
+		case POSTY_FUT:
+			/* no bearing on the nav or the bands */
+			p->fut->f_mkt = q->mkt;
+			break;
+		case POSTY_CASH:
+			p->cash->s_mkt = q->mkt;
+			if (*nd >= pf->nposs || inc_cash(pf, p->cash, nd) < 0) {
+				return -1;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	return 0;
+}
+
+static int
+inc_update(pf_t pf)
+{
+	const struct fut_col_s *fc = &pf->fc;
+	const struct cash_col_s *cc = &pf->cc;
+	durst_ctx_t ctx = pf->ctx;
+	const size_t qend = ctx->qbase + ctx->nqlog;
+	size_t nd = 0U;
+	double nav;
+	double q;
+
+	if (qend - pf->qlog > pf->nposs) {
+		/* more quotes than positions, don't bother */
+		return -1;
+	} else if (pf->qlog < qend) {
+		for (; pf->qlog < qend; pf->qlog++) {
+			size_t k = pf->qlog - ctx->qbase;
+
+			if (inc_quote(pf, ctx->qlog[k], &nd) < 0) {
+				return -1;
+			}
+		}
+		/* caught up, the log might go now */
+		ctx->nlag--;
+		inc_trim(ctx);
+	}
+
+	nav = pf->val.soft + pf->val.hard;
+	q = pf->nav_ref / nav;
+	if (!(q >= pf->qlo && q <= pf->qhi)) {
+		/* the nav moved enough to matter to the others */
+		return -1;
+	}
+	for (size_t k = 0; k < nd; k++) {
+		size_t i = pf->dirt[k];
+
+		if (i < pf->nfut) {
+			inc_check(pf, fc->brk, i, fc->pos[i], fc->stl[i],
+				  fc->lo[i], fc->hi[i], nav);
+		} else {
+			i -= pf->nfut;
+			inc_check(pf, cc->brk, i, cc->pos[i], cc->stl[i],
+				  cc->lo[i], cc->hi[i], nav);
+		}
+	}
+	return 0;
+}
+
+
+/* snapshots, portfolios as they are after reading and setting the base
+ * currency, laid out so that they can be used straight off the mapped
+ * file: position arrays are stored as they are in memory with pointers
+ * replaced by indices, symbols and market data go into tables at the end */
+#define SNAP_VER	(3U)
+#define SNAP_ALGN	(64U)
+
+struct snap_hdr_s {
+	char magic[8U];
+	uint32_t ver;
+	/* byte order and layout check */
+	uint32_t bom;
+	uint32_t zfut;
+	uint32_t zcash;
+	uint32_t zpos;
+	uint32_t pad;
+};
+
+/* in front of each portfolio, offsets are from the block start */
+struct snap_pf_s {
+	uint64_t z;
+	struct __val_s val_ini;
+	uint64_t bccy;
+	/* length of the id, or -1 if there's none */
+	uint64_t idz;
+	uint64_t nfut;
+	uint64_t ncash;
+	uint64_t nposs;
+	uint64_t id;
+	uint64_t fut;
+	uint64_t cash;
+	uint64_t poss;
+	/* futures model, or -1 for the context's */
+	int64_t model;
+};
+
+struct snap_sym_s {
+	uint64_t off;
+	uint64_t z;
+};
+
+/* at the very end */
+struct snap_ftr_s {
+	uint64_t nsym;
+	/* offset of the symbol table */
+	uint64_t sym;
+	uint64_t npf;
+	/* offset of the market data table */
+	uint64_t nmkt;
+	uint64_t mkt;
+	char magic[8U];
+};
+
+struct durst_snap_s {
+	durst_ctx_t ctx;
+	/* when writing */
+	FILE *f;
+	uint64_t off;
+	uint64_t npf;
+	/* when reading */
+	struct map_s *map;
+	const char *cur;
+	const char *end;
+	/* snapshot symbols and market data, resolved in CTX, the market
+	 * data is held until the snapshot is closed */
+	size_t nsym;
+	struct __hdr_s *sym;
+	size_t nmkt;
+	size_t zmkt;
+	struct mkt_s **mkt;
+};
+
+static const char snap_magic[8U] = "DURSTSNP";
+
+static uint64_t
+__snap_ccy(const_pfack_4217_t c)
+{
+/* iso currencies by index, custom ones by symbol */
+	if (c == NULL) {
+		return 0U;
+	} else if (c >= pfack_4217 && c < pfack_4217 + countof(pfack_4217)) {
+		return pfack_4217_id(c) + 1U;
+	}
+	return 1ULL << 32U | __4217_key(c->sym, sizeof(c->sym));
+}
+
+static const_pfack_4217_t
+__unsnap_ccy(durst_ctx_t ctx, uint64_t x)
+{
+	const_pfack_4217_t res;
+	char sym[4U] = {0};
+
+	if (x == 0U) {
+		return NULL;
+	} else if (x <= countof(pfack_4217)) {
+		return PFACK_4217(x - 1U);
+	}
+	for (size_t i = 0; i < 3U; i++) {
+		sym[i] = (char)(x >> (8U * i));
+	}
+	if ((res = __find_4217(ctx, sym, strlen(sym))) == NULL) {
+		res = __add_4217(ctx, sym, strlen(sym));
+	}
+	return res;
+}
+
+static int
+snap_write(durst_snap_t s, const void *p, size_t z)
+{
+/* write Z bytes at P and pad to the next alignment boundary */
+	static const char pad[SNAP_ALGN];
+	size_t nz = (z + SNAP_ALGN - 1U) & ~(SNAP_ALGN - 1U);
+
+	if (fwrite(p, 1, z, s->f) < z ||
+	    fwrite(pad, 1, nz - z, s->f) < nz - z) {
+		return -1;
+	}
+	s->off += nz;
+	return 0;
+}
+
+static uint64_t
+__snap_z(size_t z)
+{
+	return (z + SNAP_ALGN - 1U) & ~(SNAP_ALGN - 1U);
+}
+
+static uint32_t
+snap_hold_mkt(durst_snap_t s, const struct __mkt_s *m)
+{
+/* intern M for the footer, its ordinal must stay put until then */
+	uint32_t k = __intern_mkt(s->ctx, m);
+
+	if (s->nmkt >= s->zmkt) {
+		s->zmkt = s->zmkt ? 2U * s->zmkt : 64U;
+		s->mkt = realloc(s->mkt, s->zmkt * sizeof(*s->mkt));
+	}
+	s->mkt[s->nmkt++] = s->ctx->mkt[k];
+	return k;
+}
+
+static int
+snap_add(durst_snap_t s, pf_t pf)
+{
+	struct snap_pf_s b = {
+		.val_ini = pf->val_ini,
+		.bccy = __snap_ccy(pf->bccy),
+		.idz = pf->id ? strlen(pf->id) : (uint64_t)-1,
+		.nfut = pf->nfut,
+		.ncash = pf->ncash,
+		.nposs = pf->nposs,
+		.model = pf->model,
+	};
+	struct __fut_pos_s *fut;
+	struct __cash_pos_s *cash;
+	struct pos_s *poss;
+
+	b.id = __snap_z(sizeof(b));
+	b.fut = b.id + (pf->id ? __snap_z(b.idz + 1U) : 0U);
+	b.cash = b.fut + __snap_z(pf->nfut * sizeof(*fut));
+	b.poss = b.cash + __snap_z(pf->ncash * sizeof(*cash));
+	b.z = b.poss + __snap_z(pf->nposs * sizeof(*poss));
+
+	/* pointers become indices in copies of the arrays */
+	fut = arena_alloc(pf->arena, pf->nfut * sizeof(*fut) + 1U);
+	memcpy(fut, pf->fut, pf->nfut * sizeof(*fut));
+	for (size_t i = 0; i < pf->nfut; i++) {
+		uint32_t k = snap_hold_mkt(s, fut[i].f_mkt);
+
+		fut[i].hdr.sym = NULL;
+		fut[i].ccy = (const void*)(uintptr_t)__snap_ccy(fut[i].ccy);
+		fut[i].f_mkt = (const void*)(uintptr_t)k;
+	}
+	cash = arena_alloc(pf->arena, pf->ncash * sizeof(*cash) + 1U);
+	memcpy(cash, pf->cash, pf->ncash * sizeof(*cash));
+	for (size_t i = 0; i < pf->ncash; i++) {
+		uintptr_t bp = cash[i].bp ? cash[i].bp - pf->cash + 1U : 0U;
+		uint32_t k = snap_hold_mkt(s, cash[i].s_mkt);
+
+		cash[i].hdr.sym = NULL;
+		cash[i].tccy = (const void*)(uintptr_t)__snap_ccy(cash[i].tccy);
+		cash[i].bp = (void*)bp;
+		cash[i].s_mkt = (const void*)(uintptr_t)k;
+	}
+	poss = arena_calloc(pf->arena, pf->nposs + 1U, sizeof(*poss));
+	for (size_t i = 0; i < pf->nposs; i++) {
+		poss[i].ty = pf->poss[i].ty;
+		switch (poss[i].ty) {
+		case POSTY_FUT:
+			poss[i].i = pf->poss[i].fut - pf->fut;
+			break;
+		case POSTY_CASH:
+			poss[i].i = pf->poss[i].cash - pf->cash;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (snap_write(s, &b, sizeof(b)) < 0 ||
+	    (pf->id && snap_write(s, pf->id, b.idz + 1U) < 0) ||
+	    snap_write(s, fut, pf->nfut * sizeof(*fut)) < 0 ||
+	    snap_write(s, cash, pf->ncash * sizeof(*cash)) < 0 ||
+	    snap_write(s, poss, pf->nposs * sizeof(*poss)) < 0) {
+		return -1;
+	}
+	s->npf++;
+	return 0;
+}
+
+static int
+snap_fin(durst_snap_t s)
+{
+/* write the symbol table, the symbols, market data and the footer */
+	static const char pad[SNAP_ALGN];
+	durst_ctx_t ctx = s->ctx;
+	struct snap_ftr_s ftr = {
+		.nsym = ctx->nsym,
+		.sym = s->off,
+		.npf = s->npf,
+	};
+	struct snap_sym_s *tbl = calloc(ctx->nsym + 1U, sizeof(*tbl));
+	uint64_t soff = s->off + __snap_z(ctx->nsym * sizeof(*tbl));
+	uint64_t nz = 0U;
+	int rc;
+
+	for (size_t i = 0; i < ctx->nsym; i++) {
+		tbl[i] = (struct snap_sym_s){soff + nz, ctx->sym[i].z};
+		nz += ctx->sym[i].z;
+	}
+	rc = snap_write(s, tbl, ctx->nsym * sizeof(*tbl));
+	free(tbl);
+	for (size_t i = 0; i < ctx->nsym; i++) {
+		if (fwrite(ctx->sym[i].s, 1, ctx->sym[i].z, s->f) <
+		    ctx->sym[i].z) {
+			rc = -1;
+		}
+	}
+	/* keep the market data and the footer aligned */
+	if (fwrite(pad, 1, __snap_z(nz) - nz, s->f) < __snap_z(nz) - nz) {
+		rc = -1;
+	}
+	ftr.nmkt = ctx->nmkt;
+	ftr.mkt = soff + __snap_z(nz);
+	for (size_t i = 0; i < ctx->nmkt; i++) {
+		if (fwrite(&ctx->mkt[i]->m, sizeof(ctx->mkt[i]->m), 1U, s->f) < 1U) {
+			rc = -1;
+		}
+	}
+	nz = ctx->nmkt * sizeof(struct __mkt_s);
+	if (fwrite(pad, 1, __snap_z(nz) - nz, s->f) < __snap_z(nz) - nz) {
+		rc = -1;
+	}
+	memcpy(ftr.magic, snap_magic, sizeof(ftr.magic));
+	if (fwrite(&ftr, sizeof(ftr), 1U, s->f) < 1U) {
+		rc = -1;
+	}
+	return rc;
+}
+
+static durst_snap_t
+snap_open(durst_ctx_t ctx, const char *fn)
+{
+	const struct snap_hdr_s *hdr;
+	const struct snap_ftr_s *ftr;
+	const struct snap_sym_s *sym;
+	const struct __mkt_s *mkt;
+	durst_snap_t res;
+	struct stat st;
+	void *p;
+	int fd;
+
+	if ((fd = open(fn, O_RDONLY)) < 0) {
+		return NULL;
+	} else if (fstat(fd, &st) < 0 ||
+		   (size_t)st.st_size < sizeof(*hdr) + sizeof(*ftr)) {
+		close(fd);
+		return NULL;
+	}
+	/* private and writable, portfolios are worked on in place */
+	p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_POPULATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		return NULL;
+	}
+
+	hdr = p;
+	ftr = (const void*)((const char*)p + st.st_size - sizeof(*ftr));
+	if (memcmp(hdr->magic, snap_magic, sizeof(hdr->magic)) ||
+	    hdr->ver != SNAP_VER || hdr->bom != 0x01020304U ||
+	    hdr->zfut != sizeof(struct __fut_pos_s) ||
+	    hdr->zcash != sizeof(struct __cash_pos_s) ||
+	    hdr->zpos != sizeof(struct pos_s) ||
+	    memcmp(ftr->magic, snap_magic, sizeof(ftr->magic)) ||
+	    ftr->sym > st.st_size - sizeof(*ftr) ||
+	    ftr->nsym > (st.st_size - ftr->sym) / sizeof(*sym) ||
+	    ftr->mkt > st.st_size - sizeof(*ftr) ||
+	    ftr->nmkt > (st.st_size - ftr->mkt) / sizeof(*mkt)) {
+		/* not ours, or not from this build */
+		munmap(p, st.st_size);
+		return NULL;
+	}
+
+	res = calloc(1, sizeof(*res));
+	res->ctx = ctx;
+	res->map = malloc(sizeof(*res->map));
+	res->map->p = p;
+	res->map->z = st.st_size;
+	res->map->nref = 1U;
+	res->cur = (const char*)p + __snap_z(sizeof(*hdr));
+	res->end = (const char*)p + ftr->sym;
+
+	/* intern the symbols once, positions just look them up */
+	sym = (const void*)res->end;
+	res->nsym = ftr->nsym;
+	res->sym = malloc((res->nsym + 1U) * sizeof(*res->sym));
+	for (size_t i = 0; i < res->nsym; i++) {
+		const char *y = (const char*)p + sym[i].off;
+
+		res->sym[i] = (struct __hdr_s){
+			y, sym[i].z, __intern(ctx, y, sym[i].z),
+		};
+	}
+	/* likewise market data, shared with what's in CTX already */
+	mkt = (const void*)((const char*)p + ftr->mkt);
+	res->nmkt = ftr->nmkt;
+	res->mkt = malloc((res->nmkt + 1U) * sizeof(*res->mkt));
+	for (size_t i = 0; i < res->nmkt; i++) {
+		uint32_t k = __intern_mkt(ctx, mkt + i);
+
+		res->mkt[i] = ctx->mkt[k];
+	}
+	return res;
+}
+
+static struct __hdr_s
+snap_sym(durst_snap_t s, uint32_t id)
+{
+	if (id < s->nsym) {
+		return s->sym[id];
+	}
+	return (struct __hdr_s){"", 0U, URS_NOSYM};
+}
+
+static const struct __mkt_s*
+snap_mkt(durst_snap_t s, pf_t pf, const void *k)
+{
+	static const struct __mkt_s naught;
+
+	if ((uintptr_t)k < s->nmkt) {
+		struct mkt_s *r = s->mkt[(uintptr_t)k];
+
+		__atomic_add_fetch(&r->nref, 1U, __ATOMIC_RELAXED);
+		pf_hold_mkt(pf, r);
+		return &r->m;
+	}
+	return &naught;
+}
+
+static pf_t
+snap_read(durst_snap_t s)
+{
+	durst_ctx_t ctx = s->ctx;
+	const struct snap_pf_s *b;
+	char *blk;
+	pf_t res;
+
+	if (s->cur >= s->end) {
+		return NULL;
+	}
+	b = (const void*)s->cur;
+	blk = (char*)s->cur;
+	if (b->z < sizeof(*b) || b->z > (size_t)(s->end - s->cur) ||
+	    b->fut > b->z || b->nfut > (b->z - b->fut) / sizeof(*res->fut) ||
+	    b->cash > b->z || b->ncash > (b->z - b->cash) / sizeof(*res->cash) ||
+	    b->poss > b->z || b->nposs > (b->z - b->poss) / sizeof(*res->poss)) {
+		/* truncated or garbled */
+		s->cur = s->end;
+		return NULL;
+	}
+	s->cur += b->z;
+
+	res = make_pf(ctx);
+	res->map = map_ref(s->map);
+	res->val_ini = b->val_ini;
+	res->model = b->model >= 0 && b->model < URS_FUT_NMODELS
+		? (int)b->model : -1;
+	if (b->idz != (uint64_t)-1) {
+		res->id = blk + b->id;
+	}
+	res->nfut = res->zfut = b->nfut;
+	res->fut = (void*)(blk + b->fut);
+	res->ncash = res->zcash = b->ncash;
+	res->cash = (void*)(blk + b->cash);
+	res->nposs = res->zposs = b->nposs;
+	res->poss = (void*)(blk + b->poss);
+
+	/* turn indices back into pointers */
+	for (size_t i = 0; i < res->nfut; i++) {
+		urs_fut_pos_t fp = res->fut + i;
+
+		fp->hdr = snap_sym(s, fp->hdr.id);
+		fp->ccy = __unsnap_ccy(ctx, (uintptr_t)fp->ccy);
+		fp->f_mkt = snap_mkt(s, res, fp->f_mkt);
+	}
+	for (size_t i = 0; i < res->ncash; i++) {
+		urs_cash_pos_t cp = res->cash + i;
+		uintptr_t bp = (uintptr_t)cp->bp;
+
+		cp->hdr = snap_sym(s, cp->hdr.id);
+		cp->tccy = __unsnap_ccy(ctx, (uintptr_t)cp->tccy);
+		cp->bp = bp ? res->cash + bp - 1U : NULL;
+		cp->s_mkt = snap_mkt(s, res, cp->s_mkt);
+	}
+	res->seq = ctx->npf++;
+	res->nsym = ctx->nsym;
+	index_pf(res);
+	res->bccy = __unsnap_ccy(ctx, b->bccy);
+	return res;
+}
+
+static int
+__parse_quote(durst_ctx_t ctx, const char *line, const char *eol)
+{
+/* QUOTE sym bid ask stl */
+	const char *s = __skip_behind_tab(line, eol);
+	const char *p = __skip_behind_tab(s, eol);
+	size_t z = __field_len(s, p);
+	struct quo_s *q;
+
+	if (z == 0U) {
+		return -1;
+	}
+	/* update in place, positions referring to it see the new quotes */
+	q = __quo(ctx, __intern(ctx, s, z));
+	q->mkt->bid = read_tab_double(p, eol);
+	p = __skip_behind_tab(p, eol);
+	q->mkt->ask = read_tab_double(p, eol);
+	p = __skip_behind_tab(p, eol);
+	q->mkt->stl = read_tab_double(p, eol);
+	q->setp = true;
+
+	/* log it for incremental updates, if anyone's interested */
+	inc_trim(ctx);
+	if (ctx->ninc == 0U) {
+		return 0;
+	}
+	if (ctx->nqlog >= ctx->zqlog) {
+		ctx->zqlog = ctx->zqlog ? 2U * ctx->zqlog : 256U;
+		ctx->qlog = realloc(ctx->qlog, ctx->zqlog * sizeof(*ctx->qlog));
+	}
+	ctx->qlog[ctx->nqlog++] = (uint32_t)(q - ctx->quo);
+	ctx->nlag = ctx->ninc;
+	return 0;
+}
+
+
+/* public api */
+DEFUN durst_ctx_t
+make_durst_ctx(void)
+{
+	durst_ctx_t res = calloc(1, sizeof(*res));
+
+	pthread_mutex_init(&res->amtx, NULL);
+	res->sarena = make_arena();
+	res->marena = make_arena();
+	return res;
+}
+
+DEFUN void
+free_durst_ctx(durst_ctx_t ctx)
+{
+	free_rdr(&ctx->rdr);
+	for (struct my4217_blk_s *b = ctx->my4217_blk, *nx; b; b = nx) {
+		nx = b->next;
+		free(b);
+	}
+	if (ctx->my4217 != NULL) {
+		free(ctx->my4217);
+	}
+	for (size_t i = 0; i < ctx->narena; i++) {
+		URS_DEBUG("arena %zu: %zu mallocs\n",
+			  i, arena_nmalloc(ctx->arena[i]));
+		free_arena(ctx->arena[i]);
+	}
+	free(ctx->arena);
+	pthread_mutex_destroy(&ctx->amtx);
+	free(ctx->sym);
+	free(ctx->symh);
+	free_arena(ctx->sarena);
+	free(ctx->mkt);
+	free(ctx->mkth);
+	free(ctx->mfree);
+	free_arena(ctx->marena);
+	free(ctx->quo);
+	free(ctx->qlog);
+	for (size_t i = 0; i < ctx->nwst; i++) {
+		free(ctx->wst[i].fsym);
+		free(ctx->wst[i].fsoft);
+	}
+	free(ctx->wst);
+	free(ctx->wsth);
+	if (ctx->team != NULL) {
+		free_team(ctx->team);
+	}
+	free(ctx);
+	return;
+}
+
+DEFUN durst_pf_t
+durst_pf_read(durst_ctx_t ctx, FILE *whence)
+{
+	pf_t res;
+
+	if (ctx->rdr.whence != whence) {
+		/* new stream, start over */
+		free_rdr(&ctx->rdr);
+		ctx->rdr.whence = whence;
+		rdr_map(&ctx->rdr);
+	}
+	if ((res = read_pf(ctx)) == NULL) {
+		/* stream's exhausted, forget about it */
+		free_rdr(&ctx->rdr);
+	}
+	return res;
+}
+
+DEFUN void
+free_durst_pf(durst_pf_t pf)
+{
+	free_pf(pf);
+	return;
+}
+
+DEFUN const char*
+durst_pf_id(durst_pf_t pf)
+{
+	return pf->id;
+}
+
+DEFUN int
+durst_pf_set_base(durst_ctx_t ctx, durst_pf_t pf, const char *ccy)
+{
+	const_pfack_4217_t bccy;
+
+	if ((bccy = __find_4217(ctx, ccy, strlen(ccy))) == NULL) {
+		return -1;
+	}
+	set_base_currency(pf, bccy);
+	return 0;
+}
+
+DEFUN void
+durst_pf_lever(durst_pf_t pf, double lever)
+{
+	for (size_t i = 0; i < pf->nfut; i++) {
+		pf->fut[i].band.lo *= lever;
+		pf->fut[i].band.med *= lever;
+		pf->fut[i].band.hi *= lever;
+		fut_col_put(pf, i);
+	}
+	inc_drop(pf);
+	return;
+}
+
+DEFUN void
+durst_pf_model(durst_pf_t pf, durst_model_t model)
+{
+	pf->model = model;
+	inc_drop(pf);
+	return;
+}
+
+DEFUN int
+durst_pf_complete_p(durst_pf_t pf)
+{
+	return data_complete_p(pf);
+}
+
+DEFUN double
+durst_pf_nav(durst_pf_t pf)
+{
+	return compute_pf_val(pf);
+}
+
+DEFUN int
+durst_pf_rebalance(durst_pf_t pf)
+{
+	const struct wst_s *w;
+
+	if (pf->bccy == NULL) {
+		return -1;
+	}
+	pf->book = book_digest(pf);
+	w = warm_find(pf);
+	inc_drop(pf);
+	__work(pf, w);
+	return 0;
+}
+
+DEFUN size_t
+durst_pf_solve_stats(durst_pf_t pf, double *resid)
+{
+	if (resid != NULL) {
+		*resid = pf->resid;
+	}
+	return pf->niter;
+}
+
+DEFUN void
+durst_pf_keep(durst_pf_t pf)
+{
+	if (pf->fut0 == NULL) {
+		pf->fut0 = arena_alloc(
+			pf->arena, pf->nfut * sizeof(*pf->fut) + 1U);
+		pf->cash0 = arena_alloc(
+			pf->arena, pf->ncash * sizeof(*pf->cash) + 1U);
+	}
+	/* either array may be missing altogether */
+	if (pf->nfut > 0U) {
+		memcpy(pf->fut0, pf->fut, pf->nfut * sizeof(*pf->fut));
+	}
+	if (pf->ncash > 0U) {
+		memcpy(pf->cash0, pf->cash, pf->ncash * sizeof(*pf->cash));
+	}
+	pf->bccy0 = pf->bccy;
+	return;
+}
+
+DEFUN int
+durst_pf_reset(durst_pf_t pf)
+{
+	if (pf->fut0 == NULL) {
+		return -1;
+	}
+	/* positions only point to things that outlive them */
+	if (pf->nfut > 0U) {
+		memcpy(pf->fut, pf->fut0, pf->nfut * sizeof(*pf->fut));
+	}
+	if (pf->ncash > 0U) {
+		memcpy(pf->cash, pf->cash0, pf->ncash * sizeof(*pf->cash));
+	}
+	pf->bccy = pf->bccy0;
+	inc_drop(pf);
+	pf->niter = 0U;
+	cols_put(pf);
+	return 0;
+}
+
+DEFUN void
+durst_pf_emit_report(durst_pf_t pf, FILE *whither)
+{
+	struct obuf_s ob = {.f = whither};
+
+	fprint_poss(pf, &ob);
+	ob_flush(&ob);
+	return;
+}
+
+DEFUN void
+durst_pf_emit_state(durst_pf_t pf, FILE *whither)
+{
+	struct obuf_s ob = {.f = whither};
+	char tmp[128U];
+	int z;
+
+	if (pf->id != NULL) {
+		ob_add(&ob, "PORTFOLIO\t", 10U);
+		ob_adds(&ob, pf->id);
+		ob_addc(&ob, '\n');
+	}
+	/* the navs go in full so that they read back bit for bit */
+	z = snprintf(tmp, sizeof(tmp), "NAV\t%.17g\t%zu\t%.17g\t%016llx\n",
+		     pf->nav_fix, pf->niter, pf->nav_try,
+		     (unsigned long long)pf->book);
+	ob_add(&ob, tmp, z > 0 ? (size_t)z : 0U);
+	for (size_t i = 0; pf->niter > 0U && i < pf->nfut; i++) {
+		if (isnan(pf->lfut[i])) {
+			continue;
+		}
+		ob_add(&ob, "FUT\t", 4U);
+		ob_add(&ob, pf->fut[i].hdr.sym, pf->fut[i].hdr.symz);
+		ob_addc(&ob, '\t');
+		ob_add_4f(&ob, pf->lfut[i]);
+		ob_addc(&ob, '\n');
+	}
+	ob_flush(&ob);
+	return;
+}
+
+DEFUN void
+durst_pf_emit_trades(durst_pf_t pf, FILE *whither, durst_outfmt_t of)
+{
+	struct obuf_s ob = {.f = whither};
+
+	switch (of) {
+	case DURST_OUTFMT_CSV:
+		fprint_trades(pf, &ob);
+		break;
+	case DURST_OUTFMT_FIXML:
+		fprint_trades_fixml(pf, &ob);
+		break;
+	case DURST_OUTFMT_BIN:
+		fprint_trades_bin(pf, &ob);
+		break;
+	default:
+		break;
+	}
+	ob_flush(&ob);
+	return;
+}
+
+DEFUN void
+durst_emit_header(FILE *whither, durst_outfmt_t of)
+{
+	switch (of) {
+	case DURST_OUTFMT_BIN: {
+		unsigned char hdr[BIN_RECZ] = "DURSTBIN";
+
+		__put_le16(hdr + 8U, 1U);
+		__put_le16(hdr + 10U, BIN_RECZ);
+		fwrite(hdr, 1, sizeof(hdr), whither);
+		break;
+	}
+	default:
+		break;
+	}
+	return;
+}
+
+DEFUN durst_snap_t
+durst_snap_create(durst_ctx_t ctx, const char *fn)
+{
+	struct snap_hdr_s hdr = {
+		.ver = SNAP_VER,
+		.bom = 0x01020304U,
+		.zfut = sizeof(struct __fut_pos_s),
+		.zcash = sizeof(struct __cash_pos_s),
+		.zpos = sizeof(struct pos_s),
+	};
+	durst_snap_t res;
+	FILE *f;
+
+	if ((f = fopen(fn, "wb")) == NULL) {
+		return NULL;
+	}
+	res = calloc(1, sizeof(*res));
+	res->ctx = ctx;
+	res->f = f;
+	memcpy(hdr.magic, snap_magic, sizeof(hdr.magic));
+	if (snap_write(res, &hdr, sizeof(hdr)) < 0) {
+		fclose(f);
+		free(res);
+		return NULL;
+	}
+	return res;
+}
+
+DEFUN int
+durst_snap_add(durst_snap_t s, durst_pf_t pf)
+{
+	if (s->f == NULL || pf->bccy == NULL) {
+		return -1;
+	}
+	return snap_add(s, pf);
+}
+
+DEFUN durst_snap_t
+durst_snap_open(durst_ctx_t ctx, const char *fn)
+{
+	return snap_open(ctx, fn);
+}
+
+DEFUN durst_pf_t
+durst_snap_read(durst_snap_t s)
+{
+	if (s->map == NULL) {
+		return NULL;
+	}
+	return snap_read(s);
+}
+
+DEFUN int
+durst_snap_close(durst_snap_t s)
+{
+	int rc = 0;
+
+	if (s->f != NULL) {
+		rc = snap_fin(s);
+		rc |= fclose(s->f);
+	}
+	if (s->map != NULL) {
+		/* portfolios still hold on to the mapping */
+		map_unref(s->map);
+	}
+	free(s->sym);
+	for (size_t i = 0; i < s->nmkt; i++) {
+		__drop_mkt(s->mkt[i]);
+	}
+	free(s->mkt);
+	free(s);
+	return rc;
+}
+
+DEFUN int
+durst_read_quotes(durst_ctx_t ctx, FILE *whence)
+{
+	struct rdr_s r = {.whence = whence};
+	const char *line;
+	const char *eol;
+	size_t nquo = 0U;
+
+	rdr_map(&r);
+	while ((line = rdr_line(&r, &eol)) != NULL) {
+		static const char quote[] = "QUOTE";
+
+		if (strncmp(line, quote, sizeof(quote) - 1U) == 0 &&
+		    __parse_quote(ctx, line, eol) == 0) {
+			nquo++;
+		}
+	}
+	free_rdr(&r);
+	return nquo > 0U ? 0 : -1;
+}
+
+DEFUN int
+durst_read_quote(durst_ctx_t ctx, const char *line, size_t z)
+{
+	static const char quote[] = "QUOTE";
+	const char *eol = line + z - (z > 0U && line[z - 1U] == '\n');
+
+	if (z < sizeof(quote) - 1U ||
+	    strncmp(line, quote, sizeof(quote) - 1U)) {
+		return -1;
+	}
+	return __parse_quote(ctx, line, eol);
+}
+
+DEFUN int
+durst_read_state(durst_ctx_t ctx, FILE *whence)
+{
+	struct rdr_s r = {.whence = whence};
+	const char *line;
+	const char *eol;
+	/* portfolios may go without PORTFOLIO record */
+	struct wst_s *w = NULL;
+	size_t nw = 0U;
+
+	rdr_map(&r);
+	while ((line = rdr_line(&r, &eol)) != NULL) {
+		static const char nav[] = "NAV\t";
+		static const char fut[] = "FUT\t";
+		const char *id;
+
+		if ((id = __parse_pfid(line, eol)) != NULL) {
+			w = __wst(ctx, id, __pfid_len(id, eol));
+			/* a later state replaces an earlier one */
+			w->nfut = 0U;
+			nw++;
+		} else if (!strncmp(line, nav, sizeof(nav) - 1U)) {
+			const char *p = line + sizeof(nav) - 1U;
+
+			if (w == NULL) {
+				w = __wst(ctx, "", 0U);
+				w->nfut = 0U;
+				nw++;
+			}
+			w->nav = read_tab_double(p, eol);
+			/* the passes it took are of no concern */
+			p = __skip_behind_tab(__skip_behind_tab(p, eol), eol);
+			w->nav_try = p < eol ? read_tab_double(p, eol) : NAN;
+			w->book = read_tab_hex(__skip_behind_tab(p, eol), eol);
+		} else if (!strncmp(line, fut, sizeof(fut) - 1U) && w != NULL) {
+			const char *sy = line + sizeof(fut) - 1U;
+			const char *p = __skip_behind_tab(sy, eol);
+			size_t z = __field_len(sy, p);
+
+			if (w->nfut >= w->zfut) {
+				w->zfut = w->zfut ? 2U * w->zfut : 64U;
+				w->fsym = realloc(
+					w->fsym, w->zfut * sizeof(*w->fsym));
+				w->fsoft = realloc(
+					w->fsoft, w->zfut * sizeof(*w->fsoft));
+			}
+			w->fsym[w->nfut] = __intern(ctx, sy, z);
+			w->fsoft[w->nfut++] = read_tab_double(p, eol);
+		}
+	}
+	free_rdr(&r);
+	return nw > 0U ? 0 : -1;
+}
+
+DEFUN void
+durst_ctx_join_quotes(durst_ctx_t ctx, int joinp)
+{
+	ctx->qjoin = joinp;
+	return;
+}
+
+DEFUN void
+durst_ctx_sum(durst_ctx_t ctx, durst_sum_t sum)
+{
+	ctx->sum = sum;
+	return;
+}
+
+DEFUN void
+durst_ctx_model(durst_ctx_t ctx, durst_model_t model)
+{
+	ctx->model = model;
+	return;
+}
+
+DEFUN void
+durst_ctx_split(durst_ctx_t ctx, unsigned int nthreads)
+{
+	if (ctx->team != NULL) {
+		free_team(ctx->team);
+		ctx->team = NULL;
+	}
+	if (nthreads > 1U) {
+		ctx->team = make_team(nthreads - 1U);
+	}
+	return;
+}
+
+DEFUN void
+durst_pf_apply_quotes(durst_ctx_t ctx, durst_pf_t pf)
+{
+	const struct quo_s *q;
+
+	inc_drop(pf);
+	for (size_t i = 0; i < pf->nfut; i++) {
+		if ((q = find_quo(ctx, &pf->fut[i].hdr)) != NULL) {
+			pf->fut[i].f_mkt = q->mkt;
+		}
+	}
+	for (size_t i = 0; i < pf->ncash; i++) {
+		if ((q = find_quo(ctx, &pf->cash[i].hdr)) != NULL) {
+			pf->cash[i].s_mkt = q->mkt;
+		}
+	}
+	if (pf->bccy != NULL) {
+		/* rates feed into the valuation factors */
+		set_base_currency(pf, pf->bccy);
+	} else {
+		cols_put(pf);
+	}
+	return;
+}
+
+DEFUN size_t
+durst_pf_update(durst_ctx_t ctx, durst_pf_t pf, double *nav)
+{
+	if (pf->six == NULL) {
+		inc_index(pf);
+	}
+	if (!pf->incp || inc_update(pf) < 0) {
+		/* start over on the quotes of the moment */
+		durst_pf_apply_quotes(ctx, pf);
+		inc_full(pf);
+	}
+	if (nav != NULL) {
+		*nav = pf->val.soft + pf->val.hard;
+	}
+	return pf->nbrk;
+}
+
+/* libdurst.c ends here */
@@ -0,0 +1,160 @@
+/*** obuf.c -- buffered output of trades and reports
+ *
+ * LICENCE here
+ **/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "obuf.h"
+
+/* longest %.4f and %.6e we format ourselves, with room to spare */
+#define FMT_MAX		(64U)
+
+
+static size_t
+__fmt_4f(char *restrict buf, double x)
+{
+/* print X like %.4f would into BUF, return the number of bytes or 0
+ * if X is not finite or too large.
+ * X * 10^4 is rounded exactly (to even on ties, as printf does), the
+ * mantissa times 10^4 fits 67 bits so 128 bits are plenty. */
+#if defined __SIZEOF_INT128__
+	unsigned __int128 n;
+	uint64_t b;
+	uint64_t ip;
+	unsigned int fp;
+	int e;
+	char tmp[24U];
+	char *tp = tmp + sizeof(tmp);
+	size_t z = 0U;
+
+	memcpy(&b, &x, sizeof(b));
+	if ((e = (int)(b >> 52U) & 0x7ff) == 0x7ff) {
+		return 0U;
+	} else if (e) {
+		n = (b & 0xfffffffffffffULL) | 0x10000000000000ULL;
+		e -= 1075;
+	} else {
+		/* subnormal */
+		n = b & 0xfffffffffffffULL;
+		e = -1074;
+	}
+	if (e > 10) {
+		/* 2^63 and beyond */
+		return 0U;
+	}
+
+	n *= 10000U;
+	if (e >= 0) {
+		n <<= e;
+	} else if (e > -127) {
+		unsigned __int128 r = n & (((unsigned __int128)1U << -e) - 1U);
+		unsigned __int128 h = (unsigned __int128)1U << (-e - 1);
+
+		n >>= -e;
+		n += r > h || (r == h && (n & 1U));
+	} else {
+		/* way below half an ulp of the 4th decimal */
+		n = 0U;
+	}
+	ip = (uint64_t)(n / 10000U);
+	fp = (unsigned int)(n % 10000U);
+
+	for (size_t i = 0; i < 4U; i++, fp /= 10U) {
+		*--tp = (char)('0' + fp % 10U);
+	}
+	*--tp = '.';
+	do {
+		*--tp = (char)('0' + ip % 10U);
+	} while (ip /= 10U);
+	if (b >> 63U) {
+		buf[z++] = '-';
+	}
+	memcpy(buf + z, tp, tmp + sizeof(tmp) - tp);
+	return z + (tmp + sizeof(tmp) - tp);
+#else  /* !__SIZEOF_INT128__ */
+	(void)buf;
+	(void)x;
+	return 0U;
+#endif	/* __SIZEOF_INT128__ */
+}
+
+static inline void
+ob_room(struct obuf_s *ob, size_t z)
+{
+	if (ob->n + z > sizeof(ob->b)) {
+		ob_flush(ob);
+	}
+	return;
+}
+
+
+DEFUN void
+ob_flush(struct obuf_s *ob)
+{
+	if (ob->n > 0U) {
+		fwrite(ob->b, 1, ob->n, ob->f);
+		ob->n = 0U;
+	}
+	return;
+}
+
+DEFUN void
+ob_add(struct obuf_s *ob, const char *s, size_t z)
+{
+	ob_room(ob, z);
+	if (z > sizeof(ob->b)) {
+		fwrite(s, 1, z, ob->f);
+		return;
+	}
+	memcpy(ob->b + ob->n, s, z);
+	ob->n += z;
+	return;
+}
+
+DEFUN void
+ob_adds(struct obuf_s *ob, const char *s)
+{
+	ob_add(ob, s, strlen(s));
+	return;
+}
+
+DEFUN void
+ob_addc(struct obuf_s *ob, char c)
+{
+	ob_room(ob, 1U);
+	ob->b[ob->n++] = c;
+	return;
+}
+
+DEFUN void
+ob_add_4f(struct obuf_s *ob, double x)
+{
+	size_t z;
+
+	ob_room(ob, FMT_MAX);
+	if ((z = __fmt_4f(ob->b + ob->n, x)) == 0U) {
+		/* leave the odd ones to printf */
+		char tmp[512U];
+		int nz = snprintf(tmp, sizeof(tmp), "%.4f", x);
+
+		ob_add(ob, tmp, nz > 0 ? (size_t)nz : 0U);
+		return;
+	}
+	ob->n += z;
+	return;
+}
+
+DEFUN void
+ob_add_6e(struct obuf_s *ob, double x)
+{
+	int z;
+
+	ob_room(ob, FMT_MAX);
+	z = snprintf(ob->b + ob->n, FMT_MAX, "%.6e", x);
+	ob->n += z > 0 ? (size_t)z : 0U;
+	return;
+}
+
+/* obuf.c ends here */
@@ -0,0 +1,51 @@
+/*** obuf.h -- buffered output of trades and reports
+ *
+ * LICENCE here
+ **/
+#if !defined INCLUDED_obuf_h_
+#define INCLUDED_obuf_h_
+
+#include <stddef.h>
+#include <stdio.h>
+
+#if !defined DECLF
+# define DECLF	extern
+# define DEFUN
+#endif	/* !DECLF */
+
+#define OBUF_SIZE	(32768U)
+
+/**
+ * Output is collected here and handed to the stream in big chunks,
+ * set F and N = 0 before use and flush when done. */
+struct obuf_s {
+	FILE *f;
+	size_t n;
+	char b[OBUF_SIZE];
+};
+
+/**
+ * Write what's buffered in OB to its stream. */
+DECLF void ob_flush(struct obuf_s *ob);
+
+/**
+ * Append the Z bytes at S to OB. */
+DECLF void ob_add(struct obuf_s *ob, const char *s, size_t z);
+
+/**
+ * Append the string S to OB. */
+DECLF void ob_adds(struct obuf_s *ob, const char *s);
+
+/**
+ * Append the character C to OB. */
+DECLF void ob_addc(struct obuf_s *ob, char c);
+
+/**
+ * Append X to OB, formatted like printf()'s %.4f. */
+DECLF void ob_add_4f(struct obuf_s *ob, double x);
+
+/**
+ * Append X to OB, formatted like printf()'s %.6e. */
+DECLF void ob_add_6e(struct obuf_s *ob, double x);
+
+#endif	/* INCLUDED_obuf_h_ */
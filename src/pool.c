@@ -0,0 +1,214 @@
+/*** pool.c -- work-stealing thread pool
+ *
+ * LICENCE here
+ **/
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "pool.h"
+
+struct task_s {
+	pool_f fun;
+	void *clo;
+};
+
+/* per-worker queue, the owner takes tasks off the head (oldest first,
+ * so results come in roughly in order), thieves take them off the tail */
+struct wsq_s {
+	pthread_mutex_t mtx;
+	size_t head;
+	size_t ntasks;
+	size_t ztasks;
+	struct task_s *tasks;
+};
+
+struct wrk_s {
+	pool_t pool;
+	unsigned int self;
+	pthread_t thr;
+};
+
+struct pool_s {
+	unsigned int nwrk;
+	struct wsq_s *q;
+	struct wrk_s *wrk;
+	/* next queue to push to */
+	unsigned int rr;
+
+	/* guards gen and fin, gen counts the tasks pushed so far, idle
+	 * workers sleep on cnd until it moves */
+	pthread_mutex_t mtx;
+	pthread_cond_t cnd;
+	unsigned long gen;
+	bool fin;
+};
+
+
+static void
+wsq_push(struct wsq_s *q, struct task_s t)
+{
+	pthread_mutex_lock(&q->mtx);
+	if (q->ntasks >= q->ztasks) {
+		/* unroll the ring into a bigger one */
+		size_t nuz = q->ztasks ? 2U * q->ztasks : 64U;
+		struct task_s *nu = malloc(nuz * sizeof(*nu));
+
+		for (size_t i = 0; i < q->ntasks; i++) {
+			nu[i] = q->tasks[(q->head + i) % q->ztasks];
+		}
+		free(q->tasks);
+		q->tasks = nu;
+		q->ztasks = nuz;
+		q->head = 0U;
+	}
+	q->tasks[(q->head + q->ntasks++) % q->ztasks] = t;
+	pthread_mutex_unlock(&q->mtx);
+	return;
+}
+
+static bool
+wsq_pop_head(struct wsq_s *q, struct task_s *t)
+{
+	bool res = false;
+
+	pthread_mutex_lock(&q->mtx);
+	if (q->ntasks > 0U) {
+		*t = q->tasks[q->head];
+		q->head = (q->head + 1U) % q->ztasks;
+		q->ntasks--;
+		res = true;
+	}
+	pthread_mutex_unlock(&q->mtx);
+	return res;
+}
+
+static bool
+wsq_pop_tail(struct wsq_s *q, struct task_s *t)
+{
+	bool res = false;
+
+	/* the owner only ever holds the lock for a push or pop, so wait
+	 * for it, giving up here would have us sleep on a full queue */
+	pthread_mutex_lock(&q->mtx);
+	if (q->ntasks > 0U) {
+		*t = q->tasks[(q->head + --q->ntasks) % q->ztasks];
+		res = true;
+	}
+	pthread_mutex_unlock(&q->mtx);
+	return res;
+}
+
+static bool
+pool_grab(pool_t p, unsigned int self, struct task_s *t)
+{
+	if (wsq_pop_head(p->q + self, t)) {
+		return true;
+	}
+	/* steal from the others, start with our neighbour */
+	for (unsigned int i = 1; i < p->nwrk; i++) {
+		if (wsq_pop_tail(p->q + (self + i) % p->nwrk, t)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void*
+pool_work(void *clo)
+{
+	struct wrk_s *w = clo;
+	pool_t p = w->pool;
+	unsigned long seen;
+
+	pthread_mutex_lock(&p->mtx);
+	seen = p->gen;
+	pthread_mutex_unlock(&p->mtx);
+	while (true) {
+		struct task_s t;
+
+		if (pool_grab(p, w->self, &t)) {
+			t.fun(t.clo);
+			continue;
+		}
+
+		/* all queues were empty when we looked, so only tasks
+		 * pushed since are worth waking for */
+		pthread_mutex_lock(&p->mtx);
+		if (p->gen == seen && p->fin) {
+			pthread_mutex_unlock(&p->mtx);
+			break;
+		}
+		while (p->gen == seen && !p->fin) {
+			pthread_cond_wait(&p->cnd, &p->mtx);
+		}
+		seen = p->gen;
+		pthread_mutex_unlock(&p->mtx);
+	}
+	return NULL;
+}
+
+
+DEFUN pool_t
+make_pool(unsigned int nthreads)
+{
+	pool_t res;
+
+	if (nthreads == 0U) {
+		nthreads = 1U;
+	}
+	res = calloc(1, sizeof(*res));
+	res->nwrk = nthreads;
+	res->q = calloc(nthreads, sizeof(*res->q));
+	res->wrk = calloc(nthreads, sizeof(*res->wrk));
+	pthread_mutex_init(&res->mtx, NULL);
+	pthread_cond_init(&res->cnd, NULL);
+
+	for (unsigned int i = 0; i < nthreads; i++) {
+		pthread_mutex_init(&res->q[i].mtx, NULL);
+	}
+	for (unsigned int i = 0; i < nthreads; i++) {
+		res->wrk[i].pool = res;
+		res->wrk[i].self = i;
+		pthread_create(&res->wrk[i].thr, NULL, pool_work, res->wrk + i);
+	}
+	return res;
+}
+
+DEFUN void
+free_pool(pool_t p)
+{
+	pthread_mutex_lock(&p->mtx);
+	p->fin = true;
+	pthread_cond_broadcast(&p->cnd);
+	pthread_mutex_unlock(&p->mtx);
+
+	for (unsigned int i = 0; i < p->nwrk; i++) {
+		pthread_join(p->wrk[i].thr, NULL);
+	}
+	for (unsigned int i = 0; i < p->nwrk; i++) {
+		pthread_mutex_destroy(&p->q[i].mtx);
+		free(p->q[i].tasks);
+	}
+	pthread_cond_destroy(&p->cnd);
+	pthread_mutex_destroy(&p->mtx);
+	free(p->wrk);
+	free(p->q);
+	free(p);
+	return;
+}
+
+DEFUN void
+pool_push(pool_t p, pool_f fun, void *clo)
+{
+	struct task_s t = {fun, clo};
+
+	wsq_push(p->q + p->rr++ % p->nwrk, t);
+
+	pthread_mutex_lock(&p->mtx);
+	p->gen++;
+	pthread_cond_broadcast(&p->cnd);
+	pthread_mutex_unlock(&p->mtx);
+	return;
+}
+
+/* pool.c ends here */
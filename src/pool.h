@@ -0,0 +1,31 @@
+/*** pool.h -- work-stealing thread pool
+ *
+ * LICENCE here
+ **/
+#if !defined INCLUDED_pool_h_
+#define INCLUDED_pool_h_
+
+#if !defined DECLF
+# define DECLF	extern
+# define DEFUN
+#endif	/* !DECLF */
+
+typedef struct pool_s *pool_t;
+
+/* tasks are a function and a closure */
+typedef void(*pool_f)(void *clo);
+
+/**
+ * Create a pool of NTHREADS workers, each with its own task queue. */
+DECLF pool_t make_pool(unsigned int nthreads);
+
+/**
+ * Wait for all tasks to finish, then dispose of POOL. */
+DECLF void free_pool(pool_t pool);
+
+/**
+ * Hand FUN(CLO) to one of the workers.  Idle workers steal from
+ * the queues of busy ones, so the initial placement doesn't matter. */
+DECLF void pool_push(pool_t pool, pool_f fun, void *clo);
+
+#endif	/* INCLUDED_pool_h_ */
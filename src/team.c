@@ -0,0 +1,180 @@
+/*** team.c -- fork-join team to split one job over threads
+ *
+ * LICENCE here
+ **/
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "team.h"
+
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+# define relax()	__builtin_ia32_pause()
+#else  /* !x86 */
+# define relax()
+#endif	/* x86 */
+
+/* jobs come in quick succession while a portfolio is rebalanced, so
+ * helpers and the caller spin this long before they go to sleep */
+#define TEAM_SPIN	(1024U)
+
+struct team_s {
+	unsigned int nthr;
+	pthread_t *thr;
+	/* held by the caller of team_run() */
+	pthread_mutex_t busy;
+
+	/* the job, published under mtx, helpers sleep on go and the
+	 * caller on done */
+	pthread_mutex_t mtx;
+	pthread_cond_t go;
+	pthread_cond_t done;
+	unsigned long gen;
+	team_f fun;
+	void *clo;
+	size_t n;
+	/* next task to hand out, tasks not finished, helpers on the job */
+	size_t next;
+	size_t left;
+	unsigned int nact;
+	bool fin;
+};
+
+
+static void
+team_grab(team_t t, team_f fun, void *clo, size_t n)
+{
+	size_t k;
+
+	while ((k = __atomic_fetch_add(&t->next, 1U, __ATOMIC_RELAXED)) < n) {
+		fun(clo, k);
+		__atomic_sub_fetch(&t->left, 1U, __ATOMIC_RELEASE);
+	}
+	return;
+}
+
+static void*
+team_work(void *clo)
+{
+	team_t t = clo;
+	unsigned long seen = 0UL;
+
+	while (true) {
+		team_f fun;
+		void *fclo;
+		size_t n;
+
+		for (unsigned int i = 0; i < TEAM_SPIN &&
+			     __atomic_load_n(&t->gen, __ATOMIC_ACQUIRE) == seen &&
+			     !__atomic_load_n(&t->fin, __ATOMIC_RELAXED); i++) {
+			relax();
+		}
+
+		pthread_mutex_lock(&t->mtx);
+		while (t->gen == seen && !t->fin) {
+			pthread_cond_wait(&t->go, &t->mtx);
+		}
+		if (t->fin) {
+			pthread_mutex_unlock(&t->mtx);
+			break;
+		}
+		/* take the job up, team_run() won't hand out another
+		 * one before we're off it again */
+		seen = t->gen;
+		fun = t->fun;
+		fclo = t->clo;
+		n = t->n;
+		t->nact++;
+		pthread_mutex_unlock(&t->mtx);
+
+		team_grab(t, fun, fclo, n);
+
+		pthread_mutex_lock(&t->mtx);
+		if (--t->nact == 0U) {
+			pthread_cond_broadcast(&t->done);
+		}
+		pthread_mutex_unlock(&t->mtx);
+	}
+	return NULL;
+}
+
+
+DEFUN team_t
+make_team(unsigned int nthreads)
+{
+	team_t res = calloc(1, sizeof(*res));
+
+	res->nthr = nthreads;
+	res->thr = calloc(nthreads + 1U, sizeof(*res->thr));
+	pthread_mutex_init(&res->busy, NULL);
+	pthread_mutex_init(&res->mtx, NULL);
+	pthread_cond_init(&res->go, NULL);
+	pthread_cond_init(&res->done, NULL);
+
+	for (unsigned int i = 0; i < nthreads; i++) {
+		pthread_create(res->thr + i, NULL, team_work, res);
+	}
+	return res;
+}
+
+DEFUN void
+free_team(team_t t)
+{
+	pthread_mutex_lock(&t->mtx);
+	__atomic_store_n(&t->fin, true, __ATOMIC_RELAXED);
+	pthread_cond_broadcast(&t->go);
+	pthread_mutex_unlock(&t->mtx);
+
+	for (unsigned int i = 0; i < t->nthr; i++) {
+		pthread_join(t->thr[i], NULL);
+	}
+	pthread_cond_destroy(&t->done);
+	pthread_cond_destroy(&t->go);
+	pthread_mutex_destroy(&t->mtx);
+	pthread_mutex_destroy(&t->busy);
+	free(t->thr);
+	free(t);
+	return;
+}
+
+DEFUN void
+team_run(team_t t, team_f fun, void *clo, size_t n)
+{
+	if (t == NULL || n <= 1U || pthread_mutex_trylock(&t->busy)) {
+		for (size_t k = 0; k < n; k++) {
+			fun(clo, k);
+		}
+		return;
+	}
+
+	pthread_mutex_lock(&t->mtx);
+	while (t->nact > 0U) {
+		/* stragglers of the last job */
+		pthread_cond_wait(&t->done, &t->mtx);
+	}
+	t->fun = fun;
+	t->clo = clo;
+	t->n = n;
+	t->next = 0U;
+	t->left = n;
+	__atomic_store_n(&t->gen, t->gen + 1UL, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(&t->go);
+	pthread_mutex_unlock(&t->mtx);
+
+	team_grab(t, fun, clo, n);
+
+	for (unsigned int i = 0; i < TEAM_SPIN &&
+		     __atomic_load_n(&t->left, __ATOMIC_ACQUIRE) > 0U; i++) {
+		relax();
+	}
+	pthread_mutex_lock(&t->mtx);
+	while (__atomic_load_n(&t->left, __ATOMIC_ACQUIRE) > 0U) {
+		/* the last tasks are still being done, their helpers
+		 * will signal once they're off the job */
+		pthread_cond_wait(&t->done, &t->mtx);
+	}
+	pthread_mutex_unlock(&t->mtx);
+	pthread_mutex_unlock(&t->busy);
+	return;
+}
+
+/* team.c ends here */
@@ -0,0 +1,36 @@
+/*** team.h -- fork-join team to split one job over threads
+ *
+ * LICENCE here
+ **/
+#if !defined INCLUDED_team_h_
+#define INCLUDED_team_h_
+
+#include <stddef.h>
+
+#if !defined DECLF
+# define DECLF	extern
+# define DEFUN
+#endif	/* !DECLF */
+
+typedef struct team_s *team_t;
+
+/* tasks are numbered 0 to n - 1, all sharing one closure */
+typedef void(*team_f)(void *clo, size_t k);
+
+/**
+ * Create a team of NTHREADS helpers, the caller of team_run() makes
+ * one more. */
+DECLF team_t make_team(unsigned int nthreads);
+
+/**
+ * Dispose of TEAM, it must not be running. */
+DECLF void free_team(team_t team);
+
+/**
+ * Run FUN(CLO, k) for k from 0 to N - 1 and return when all are done.
+ * The tasks are shared out among the caller and TEAM's helpers, if TEAM
+ * is NULL or busy with another caller's tasks the caller does them all
+ * itself.  Either way tasks must not depend on the order they run in. */
+DECLF void team_run(team_t team, team_f fun, void *clo, size_t n);
+
+#endif	/* INCLUDED_team_h_ */
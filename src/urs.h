@@ -1,8 +1,18 @@
 #if !defined INCLUDED_urs_h_
 #define INCLUDED_urs_h_
 
+#include <stddef.h>
+#include <stdint.h>
+
+/* symbol id for things that are no instruments */
+#define URS_NOSYM	((uint32_t)-1)
+
 struct __hdr_s {
-	char *sym;
+	/* not necessarily nul terminated, may point into the input */
+	const char *sym;
+	size_t symz;
+	/* interned id, unique within a durst context */
+	uint32_t id;
 };
 
 struct __val_s {
@@ -11,24 +11,23 @@
 #if !defined UNUSED
 # define UNUSED(x)	__attribute__((unused)) x
 #endif	/* !UNUSED */
-#define FEE_AWARE	1
 
 static double
 term_to_base(urs_cash_pos_t cp, double amt)
 {
-	return amt / cp->s_mkt.ask;
+	return amt / cp->s_mkt->ask;
 }
 
 static double
 term_in_base(urs_cash_pos_t cp, double amt)
 {
-	return amt / cp->s_mkt.stl;
+	return amt / cp->s_mkt->stl;
 }
 
 static double __attribute__((unused))
 base_to_term(urs_cash_pos_t cp, double amt)
 {
-	return amt * cp->s_mkt.bid;
+	return amt * cp->s_mkt->bid;
 }
 
 DEFUN double
@@ -55,7 +54,7 @@ cash_cost(urs_cash_pos_t cp, double amt)
 }
 
 DEFUN void
-urs_cash_relanav(urs_cash_pos_t cp, const double nav)
+urs_cash_relanav_bk(urs_cash_pos_t cp, const double nav, double *bk)
 {
 /* nav is given in terms, convert to base and rebalance to meet the band */
 	double tgt;
@@ -64,7 +63,7 @@ urs_cash_relanav(urs_cash_pos_t cp, const double nav)
 	double cost;
 	double err;
 
-	if (cp->s_mkt.stl <= 0.0) {
+	if (cp->s_mkt->stl <= 0.0) {
 		return;
 	} else if (cp->band.med < 0.0) {
 		return;
@@ -82,11 +81,18 @@ urs_cash_relanav(urs_cash_pos_t cp, const double nav)
 	URS_DEBUG("-> %.6f %.6f v %.6f\n", tgt, err, cp->band.med);
 	if (err > cp->band.lo && err < cp->band.hi || 1) {
 		cp->forex += dv_t;
-		cp->bp->forex -= dv_b + cost;
+		*(bk ? bk : &cp->bp->forex) -= dv_b + cost;
 	}
 	return;
 }
 
+DEFUN void
+urs_cash_relanav(urs_cash_pos_t cp, const double nav)
+{
+	urs_cash_relanav_bk(cp, nav, NULL);
+	return;
+}
+
 DEFUN double
 urs_cash_setl(urs_cash_pos_t UNUSED(cp))
 {
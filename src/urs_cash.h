@@ -13,8 +13,8 @@ struct __cash_pos_s {
 	/* this currency */
 	const_pfack_4217_t tccy;
 
-	/* bid and ask to base ccy, spot */
-	struct __mkt_s s_mkt;
+	/* bid and ask to base ccy, spot, shared with other positions */
+	const struct __mkt_s *s_mkt;
 	/* >0 if s_mkt is quoted in this currency,
 	 * <0 if this s_mkt's base is this currency,
 	 * 0 otherwise */
@@ -50,6 +50,8 @@ struct __cash_pos_s {
 DECLF double urs_cash_value(urs_cash_pos_t fp);
 /* rebalance cash positions */
 DECLF void urs_cash_relanav(urs_cash_pos_t cp, const double nav);
+/* same but book the counter trade into BK rather than the base position */
+DECLF void urs_cash_relanav_bk(urs_cash_pos_t cp, const double nav, double *bk);
 
 /* in terms */
 DECLF double urs_cash_setl(urs_cash_pos_t fp);
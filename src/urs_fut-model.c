@@ -0,0 +1,110 @@
+/*** urs_fut-model.c -- the kernels of one futures model
+ *
+ * LICENCE here
+ *
+ * Included by urs_fut.c once per model, with MODEL(x) naming the
+ * model's kernels and ROLAND_EXP defined for the closed form, so each
+ * model comes with its flags folded in.
+ **/
+#if defined ROLAND_EXP
+# define RE_UNUSED(x)	UNUSED(x)
+#else
+# define RE_UNUSED(x)	x
+#endif	/* !ROLAND_EXP */
+
+static double
+MODEL(fut_value_fun)(urs_fut_pos_t RE_UNUSED(fp), double RE_UNUSED(contracts))
+{
+#if !defined ROLAND_EXP
+	return (fp->f_mkt->stl - fp->s_mkt.stl) * contracts * fp->mult;
+#else
+	return 0;
+#endif
+}
+
+static double
+MODEL(fut_value)(urs_fut_pos_t fp)
+{
+	return MODEL(fut_value_fun)(fp, fp->pos.soft + fp->pos.hard);
+}
+
+#if !defined ROLAND_EXP
+static double
+MODEL(fut_deriv)(urs_fut_pos_t fp, double dpos)
+{
+	double onev = MODEL(fut_value_fun)(fp, 1);
+	double beta = fp->band.med;
+	return onev + __asgn(dpos, beta * fp->fee);
+}
+
+static double
+MODEL(fut_weight)(urs_fut_pos_t fp, double dpos, double nav)
+{
+	double beta = fp->band.med;
+	double npv = MODEL(fut_value_fun)(fp, fp->pos.hard);
+	double dpv = MODEL(fut_value_fun)(fp, dpos);
+	return dpv + beta * fabs(dpos) * fp->fee - beta * nav + npv;
+}
+
+static double
+MODEL(fut_newt_step)(urs_fut_pos_t fp, double dpos, double nav)
+{
+	double fpv = MODEL(fut_weight)(fp, dpos, nav);
+	double fpdv = MODEL(fut_deriv)(fp, dpos);
+	return dpos - fpv / fpdv;
+}
+#else
+static double
+MODEL(fut_newt_step)(urs_fut_pos_t fp, double RE_UNUSED(dpos), double nav)
+{
+	return fp->band.med * nav - fp->pos.hard;
+}
+#endif	/* !ROLAND_EXP */
+
+static double
+MODEL(settle)(urs_fut_pos_t fp)
+{
+/* round the whole shebang and compute trades */
+	double dpr = fp->pos.soft = fut_round(fp);
+	struct __gross_cost_s cost;
+
+	fp->term.soft = MODEL(fut_value)(fp);
+	cost = fut_cost(fp);
+	fp->term.hard = -cost.fee;
+	URS_DEBUG("-> r %.4f %.4f  f %.4f s %.4f\n",
+		  dpr, fp->term.soft / fp->val_fac, cost.fee, cost.spread);
+	return dpr;
+}
+
+static void
+MODEL(relanav_from)(urs_fut_pos_t fp, double nav, double dpos)
+{
+/* Newton off DPOS, rounding can have it swing between two contract
+ * counts forever, hence the cap, where the derivative vanishes (quotes
+ * at spot and nothing traded) there's no telling, leave it be */
+	double dpr = NAN;
+
+	URS_DEBUG("%.*s reba %.6f\n", (int)fp->hdr.symz, fp->hdr.sym, nav);
+	for (size_t i = 0U; i < NEWT_MAX; i++) {
+		const double opr = dpr;
+
+		dpos = MODEL(fut_newt_step)(fp, dpos, nav);
+		if (!isfinite(dpos)) {
+			fp->pos.soft = 0.0;
+			MODEL(settle)(fp);
+			break;
+		}
+		fp->pos.soft = dpos;
+		if ((dpr = MODEL(settle)(fp)) == opr) {
+			break;
+		}
+#if defined ROLAND_EXP
+		break;
+#endif	/* ROLAND_EXP */
+	}
+	return;
+}
+
+#undef RE_UNUSED
+
+/* urs_fut-model.c ends here */
@@ -12,15 +12,6 @@
 # define UNUSED(x)	__attribute__((unused)) x
 #endif	/* !UNUSED */
 
-#define FEE_AWARE	1
-#define ROLAND_EXP	1
-
-#if defined ROLAND_EXP
-# define RE_UNUSED(x)	UNUSED(x)
-#else
-# define RE_UNUSED(x)	x
-#endif	/* !ROLAND_EXP */
-
 /* We employ newton's method, as follows:
  * We assume last day's rebalancing was successful and the following holds
  *   (F0^i - S^i) * p^i * m = D0^i  (= beta_i N0)
@@ -64,7 +55,7 @@
  * well, the other way around, we can't rebalance futures whose quotes
  * are closely similar to the spot prices, as the derivative might vanish */
 
-static double __attribute__((unused))
+static double
 __asgn(double x, double v)
 {
 	if (x == 0.0) {
@@ -78,63 +69,6 @@ __asgn(double x, double v)
 	}
 }
 
-static double
-fut_value_fun(urs_fut_pos_t RE_UNUSED(fp), double RE_UNUSED(contracts))
-{
-#if !defined ROLAND_EXP
-	return (fp->f_mkt.stl - fp->s_mkt.stl) * contracts * fp->mult;
-#else
-	return 0;
-#endif
-}
-
-static double
-fut_value(urs_fut_pos_t fp)
-{
-	return fut_value_fun(fp, fp->pos.soft + fp->pos.hard);
-}
-
-#if !defined ROLAND_EXP
-static double
-fut_deriv(urs_fut_pos_t fp, double dpos)
-{
-	double onev = fut_value_fun(fp, 1);
-#if defined FEE_AWARE
-	double beta = fp->band.med;
-	return onev + __asgn(dpos, beta * fp->fee);
-#else  /* !FEE_AWARE */
-	return onev + __asgn(dpos, fp->fee);
-#endif	/* FEE_AWARE */
-}
-
-static double
-fut_weight(urs_fut_pos_t fp, double dpos, double nav)
-{
-	double beta = fp->band.med;
-	double npv = fut_value_fun(fp, fp->pos.hard);
-	double dpv = fut_value_fun(fp, dpos);
-#if defined FEE_AWARE
-	return dpv + beta * fabs(dpos) * fp->fee - beta * nav + npv;
-#else  /* !FEE_AWARE */
-	return dpv + fabs(dpos) * fp->fee - beta * nav + npv;
-#endif	/* FEE_AWARE */
-}
-
-static double
-fut_newt_step(urs_fut_pos_t fp, double dpos, double nav)
-{
-	double fpv = fut_weight(fp, dpos, nav);
-	double fpdv = fut_deriv(fp, dpos);
-	return dpos - fpv / fpdv;
-}
-#else
-static double
-fut_newt_step(urs_fut_pos_t fp, double RE_UNUSED(dpos), double nav)
-{
-	return fp->band.med * nav - fp->pos.hard;
-}
-#endif	/* !ROLAND_EXP */
-
 static double
 fut_round(urs_fut_pos_t fp)
 {
@@ -157,66 +91,72 @@ fut_cost(urs_fut_pos_t fp)
 	res.fee = fabs(fp->pos.soft) * fp->fee;
 
 	if (fp->pos.soft > 0.0) {
-		spr = (fp->f_mkt.ask - fp->f_mkt.stl);
+		spr = (fp->f_mkt->ask - fp->f_mkt->stl);
 	} else {
-		spr = (fp->f_mkt.bid - fp->f_mkt.stl);
+		spr = (fp->f_mkt->bid - fp->f_mkt->stl);
 	}
 	res.spread = spr * fp->pos.soft * fp->mult;
 	return res;
 }
 
+/* the models, ROLAND_EXP sizes futures by their exposure in closed form,
+ * the other one runs Newton with the fee split by weight as above */
+/* Newton steps before settling for the contract count we've got */
+#define NEWT_MAX	(16U)
+
+#define MODEL(x)	x##_roland
+#define ROLAND_EXP	1
+#include "urs_fut-model.c"
+#undef ROLAND_EXP
+#undef MODEL
+
+#define MODEL(x)	x##_fee_aware
+#include "urs_fut-model.c"
+#undef MODEL
+
+DEFUN const struct urs_fut_kern_s urs_fut_kern[URS_FUT_NMODELS] = {
+	[URS_FUT_ROLAND] = {
+		.relanav = relanav_from_roland,
+		.value = fut_value_roland,
+		.settle = settle_roland,
+	},
+	[URS_FUT_FEE_AWARE] = {
+		.relanav = relanav_from_fee_aware,
+		.value = fut_value_fee_aware,
+		.settle = settle_fee_aware,
+	},
+};
+
 DEFUN void
-urs_fut_relanav(urs_fut_pos_t fp, const double nav)
+urs_fut_relanav(urs_fut_pos_t fp, urs_fut_model_t m, const double nav)
 {
-	const double tgt = fp->band.med * nav;
-
-	URS_DEBUG("%s reba %.6f\n", fp->hdr.sym, nav);
-	for (double dpos = 0.0, dpr = -1.0, opr = 0.0; dpr != opr;) {
-		double nv;
-		double err = 0.0;
-		struct __gross_cost_s cost;
-
-		dpos = fp->pos.soft = fut_newt_step(fp, dpos, nav + err);
-		/* round the whole shebang and compute trades */
-		opr = dpr;
-		dpr = fp->pos.soft = fut_round(fp);
-		nv = (fp->term.soft = fut_value(fp)) / fp->val_fac;
-		cost = fut_cost(fp);
-
-		err = tgt - (nv + (cost.fee + cost.spread) * fp->val_fac);
-		fp->term.hard = -cost.fee;
-		URS_DEBUG("-> %.4f  r %.4f %.4f  f %.4f s %.4f  e %.4f\n",
-			  dpos, dpr, nv, cost.fee, cost.spread, err);
-#if defined ROLAND_EXP
-		break;
-#endif	/* ROLAND_EXP */
-	}
+	urs_fut_kern[m].relanav(fp, nav, 0.0);
 	return;
 }
 
 DEFUN double
-urs_fut_value(urs_fut_pos_t fp)
+urs_fut_value(urs_fut_pos_t fp, urs_fut_model_t m)
 {
-	return fut_value(fp);
+	return urs_fut_kern[m].value(fp);
 }
 
 DEFUN double
 urs_fut_setl(urs_fut_pos_t fp)
 {
 	double contracts = fp->pos.soft + fp->pos.hard;
-	return (fp->f_mkt.stl - fp->s_mkt.stl) * contracts * fp->mult;
+	return (fp->f_mkt->stl - fp->s_mkt.stl) * contracts * fp->mult;
 }
 
 #if defined TEST
 static struct __fut_pos_s GI = {
-	.hdr = {.sym = "GI___CCS"},
+	.hdr = {.sym = "GI___CCS", .symz = 8U},
 
 	.pos = {
 		 .hard = 400.0,
 		 .soft = 0.0,
 	 },
 
-	.f_mkt = {
+	.f_mkt = &(struct __mkt_s){
 		 .stl = 190.90,
 		 .bid = 190.80,
 		 .ask = 191.20,
@@ -239,7 +179,7 @@ static struct __fut_pos_s GI = {
 int
 main(int argc, char *argv[])
 {
-	urs_fut_relanav(&GI, 81000.0);
+	urs_fut_relanav(&GI, URS_FUT_ROLAND, 81000.0);
 	return 0;
 }
 #endif	/* TEST */
@@ -11,8 +11,9 @@ struct __fut_pos_s {
 	/* position in our portfolio */
 	struct __val_s pos;
 	/* future and spot market info, spot market is used to determine
-	 * the present value of a future */
-	struct __mkt_s f_mkt;
+	 * the present value of a future, the future market is shared
+	 * with other positions and portfolios */
+	const struct __mkt_s *f_mkt;
 	struct __mkt_s s_mkt;
 
 	double mult;
@@ -32,8 +33,31 @@ struct __fut_pos_s {
 	const_pfack_4217_t ccy;
 };
 
-DECLF double urs_fut_value(urs_fut_pos_t fp);
-DECLF void urs_fut_relanav(urs_fut_pos_t fp, const double nav);
+/* how futures are sized to their target weight */
+typedef enum {
+	/* by exposure, in closed form */
+	URS_FUT_ROLAND,
+	/* by Newton, with the fee split by weight */
+	URS_FUT_FEE_AWARE,
+	URS_FUT_NMODELS,
+} urs_fut_model_t;
+
+/* a model's kernels */
+struct urs_fut_kern_s {
+	/* rebalance to NAV, starting Newton off DPOS contracts */
+	void(*relanav)(urs_fut_pos_t fp, double nav, double dpos);
+	/* the value of the position in the model's terms */
+	double(*value)(urs_fut_pos_t fp);
+	/* round pos.soft to whole contracts and book value and fee, as
+	 * relanav does when done, return the contracts */
+	double(*settle)(urs_fut_pos_t fp);
+};
+
+DECLF const struct urs_fut_kern_s urs_fut_kern[URS_FUT_NMODELS];
+
+/* the same by model M, starting off 0 contracts */
+DECLF double urs_fut_value(urs_fut_pos_t fp, urs_fut_model_t m);
+DECLF void urs_fut_relanav(urs_fut_pos_t fp, urs_fut_model_t m, const double nav);
 
 /* in terms */
 DECLF double urs_fut_setl(urs_fut_pos_t fp);